@@ -1,5 +1,8 @@
 #include "atom.h"
 
+#include <bit>
+#include <cstdint>
+
 Atom::Atom() {
     m_type = Atom::Type::None;
 }
@@ -9,8 +12,9 @@ Atom::Atom(const std::string &s) {
     m_data = s;
 }
 
+// Magnitudes below 1e-10 are zero, and numbers closer than that are equal.
 bool roundsToZero(double value) {
-	return fabs(value) < std::pow(1, -10);
+	return fabs(value) < 1e-10;
 }
 
 Atom::Atom(double n) : m_type(Type::Number) {
@@ -79,7 +83,24 @@ bool Atom::operator==(const Atom& other) const noexcept {
 			diff += fabs(asComplex().imag() - other.asComplex().imag());
 			return !std::isnan(diff) && roundsToZero(diff);
 		case Type::Symbol:
-			return asSymbol() == other.asSymbol();
+			return std::get<std::string>(m_data) == std::get<std::string>(other.m_data);
+		default:
+			return true;
+	}
+}
+
+bool Atom::identical(const Atom& other) const noexcept {
+	if (m_type != other.m_type)
+		return false;
+
+	auto bits = [](double value) { return std::bit_cast<std::uint64_t>(value); };
+	switch (m_type) {
+		case Type::Number:
+			return bits(asNumber()) == bits(other.asNumber());
+		case Type::Complex:
+			return bits(asNumber()) == bits(other.asNumber()) && bits(m_imag) == bits(other.m_imag);
+		case Type::Symbol:
+			return std::get<std::string>(m_data) == std::get<std::string>(other.m_data);
 		default:
 			return true;
 	}
@@ -98,7 +119,7 @@ bool Atom::operator<(const Atom& other) const noexcept
             return asNumber() < other.asNumber();
 		case Type::Symbol:
 			if (other.m_type == Type::Symbol) {
-				return asSymbol() < other.asSymbol();
+				return std::get<std::string>(m_data) < std::get<std::string>(other.m_data);
 			}
 			else
 				return false;
@@ -0,0 +1,131 @@
+#include "batch.h"
+#include "token.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace batch {
+
+std::vector<Job> split(const std::string& text) {
+	std::vector<Job> jobs;
+	std::size_t line = 1;
+	std::size_t i = 0, n = text.size();
+
+	auto advance = [&] {
+		if (text[i++] == '\n')
+			line++;
+	};
+	auto skip_comment = [&] {
+		while (i < n && text[i] != '\n')
+			i++;
+	};
+
+	while (i < n) {
+		char c = text[i];
+		if (std::isspace(static_cast<unsigned char>(c))) {
+			advance();
+			continue;
+		}
+		if (c == COMMENT_CHAR) {
+			skip_comment();
+			continue;
+		}
+
+		std::size_t begin = i, start_line = line;
+		if (c == OPEN_CHAR) {
+			// up to the matching ')', or the end of the text if there is none
+			std::size_t depth = 0;
+			while (i < n) {
+				c = text[i];
+				if (c == COMMENT_CHAR) {
+					skip_comment();
+					continue;
+				}
+				if (c == QUOTE_CHAR) {
+					advance();
+					while (i < n && text[i] != QUOTE_CHAR)
+						advance();
+					if (i < n)
+						advance();
+					continue;
+				}
+				advance();
+				if (c == OPEN_CHAR)
+					depth++;
+				else if (c == CLOSE_CHAR && --depth == 0)
+					break;
+			}
+		}
+		else if (c == CLOSE_CHAR) {
+			advance();
+		}
+		else {
+			while (i < n && !std::isspace(static_cast<unsigned char>(text[i]))
+				&& text[i] != OPEN_CHAR && text[i] != CLOSE_CHAR && text[i] != COMMENT_CHAR)
+				advance();
+		}
+
+		jobs.push_back({ text.substr(begin, i - begin), start_line });
+	}
+
+	return jobs;
+}
+
+void run(const std::vector<Job>& jobs, Interpreter& interp, std::size_t workers,
+	const std::function<void(std::size_t, const Outcome&)>& emit) {
+
+	workers = std::clamp<std::size_t>(workers, 1, std::max<std::size_t>(jobs.size(), 1));
+
+	std::vector<std::optional<Outcome>> outcomes(jobs.size());
+	std::atomic<std::size_t> next_job{0};
+	std::mutex lock;
+	std::condition_variable finished;
+
+	auto work = [&](Interpreter own) {
+		for (std::size_t i = next_job++; i < jobs.size(); i = next_job++) {
+			Result result = own.run_isolated(jobs[i].program);
+
+			Outcome outcome{ static_cast<bool>(result), {} };
+			if (result) {
+				std::ostringstream out;
+				out << *result;
+				outcome.text = out.str();
+			}
+			else {
+				outcome.text = result.error().message();
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				outcomes[i] = std::move(outcome);
+			}
+			finished.notify_one();
+		}
+	};
+
+	// forked one at a time: fork() moves interp's own bindings into a shared layer
+	std::vector<std::thread> threads;
+	for (std::size_t w = 0; w < workers; w++)
+		threads.emplace_back(work, interp.fork());
+
+	for (std::size_t i = 0; i < jobs.size(); i++) {
+		std::optional<Outcome> outcome;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			finished.wait(guard, [&] { return outcomes[i].has_value(); });
+			outcome = std::move(outcomes[i]);
+		}
+		emit(i, *outcome);
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+}
@@ -0,0 +1,112 @@
+#include "budget.h"
+
+#include <string>
+
+namespace {
+	thread_local Budget* current_budget = nullptr;
+
+	// The deadline is compared with the clock once per this many steps.
+	constexpr std::uint64_t CLOCK_INTERVAL = 1024;
+}
+
+bool Cancellation::cancel() noexcept {
+	// a second request while the first is pending is left to the caller
+	if (!running.load())
+		return false;
+	return !stop.exchange(true);
+}
+
+bool Cancellation::requested() const noexcept {
+	return stop.load(std::memory_order_relaxed);
+}
+
+Budget::Budget(const Limits& limits, Cancellation* cancellation, const MemoryAccount* memory)
+	: limits(limits), deadline(std::chrono::steady_clock::now() + limits.deadline), cancellation(cancellation),
+	memory(memory) {
+
+	if (cancellation != nullptr) {
+		cancellation->stop.store(false);
+		cancellation->running.store(true);
+	}
+}
+
+Budget::~Budget() {
+	if (cancellation != nullptr) {
+		cancellation->running.store(false);
+		cancellation->stop.store(false);
+	}
+}
+
+std::optional<Error> Budget::step(std::uint64_t steps) {
+	if (Stop why = reason.load(std::memory_order_relaxed); why != Stop::None)
+		return stopped(why);
+
+	std::uint64_t before = used.fetch_add(steps, std::memory_order_relaxed);
+	if (limits.fuel != 0 && before + steps > limits.fuel)
+		return stopped(Stop::Fuel);
+
+	if (memory != nullptr && memory->exceeded())
+		return stopped(Stop::Memory);
+
+	if (cancellation != nullptr && cancellation->requested())
+		return stopped(Stop::Cancelled);
+
+	if (limits.deadline.count() != 0 && before / CLOCK_INTERVAL != (before + steps) / CLOCK_INTERVAL
+		&& std::chrono::steady_clock::now() > deadline)
+		return stopped(Stop::Deadline);
+
+	return std::nullopt;
+}
+
+std::optional<Error> Budget::allocate(std::size_t bytes) const {
+	if (limits.max_alloc != 0 && bytes > limits.max_alloc) {
+		return Error("Error: allocation of " + std::to_string(bytes) + " bytes exceeds the limit of "
+			+ std::to_string(limits.max_alloc) + " bytes", Stop::Allocation);
+	}
+	if (memory != nullptr && !memory->admits(bytes)) {
+		return Error("Error: allocation of " + std::to_string(bytes) + " bytes would exceed the memory limit of "
+			+ std::to_string(memory->limit()) + " bytes", Stop::Memory);
+	}
+	return std::nullopt;
+}
+
+std::optional<Error> Budget::stopped(Stop why) {
+	// every later step reports the same reason
+	Stop none = Stop::None;
+	reason.compare_exchange_strong(none, why);
+
+	switch (why = reason.load()) {
+		case Stop::Fuel:
+			return Error("Error: evaluation ran out of fuel after " + std::to_string(limits.fuel) + " steps", why);
+		case Stop::Deadline:
+			return Error("Error: evaluation passed its deadline of " + std::to_string(limits.deadline.count()) + " ms", why);
+		case Stop::Memory:
+			return Error("Error: evaluation exceeded the memory limit of " + std::to_string(memory->limit()) + " bytes", why);
+		default:
+			return Error("Error: evaluation interrupted", Stop::Cancelled);
+	}
+}
+
+Budget* Budget::current() noexcept {
+	return current_budget;
+}
+
+std::optional<Error> Budget::charge(std::uint64_t steps) {
+	if (current_budget == nullptr)
+		return std::nullopt;
+	return current_budget->step(steps);
+}
+
+std::optional<Error> Budget::reserve(std::size_t bytes) {
+	if (current_budget == nullptr)
+		return std::nullopt;
+	return current_budget->allocate(bytes);
+}
+
+Budget::Scope::Scope(Budget* budget) noexcept : previous(current_budget) {
+	current_budget = budget;
+}
+
+Budget::Scope::~Scope() {
+	current_budget = previous;
+}
@@ -0,0 +1,243 @@
+#include "csv.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+
+#ifdef _WIN32
+#define PLOTSCRIPT_NO_MMAP 1
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace csv {
+
+namespace {
+
+	// Smallest chunk handed to a worker, so small files are parsed in one go.
+	constexpr std::size_t CHUNK_BYTES = 1 << 20;
+
+	// Read-only view of a whole file: mapped where the platform allows it,
+	// otherwise read into memory.
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path) {
+#ifdef PLOTSCRIPT_NO_MMAP
+			std::ifstream in(path, std::ios::binary);
+			if (!in)
+				return;
+			contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			begin = contents.data();
+			length = contents.size();
+			open = true;
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return;
+
+			struct stat info {};
+			if (::fstat(fd, &info) == 0) {
+				length = static_cast<std::size_t>(info.st_size);
+				open = true;
+				if (length > 0) {
+					void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (mapped == MAP_FAILED) {
+						open = false;
+					}
+					else {
+						::madvise(mapped, length, MADV_SEQUENTIAL);
+						begin = static_cast<const char*>(mapped);
+					}
+				}
+			}
+			::close(fd);
+#endif
+		}
+
+		~MappedFile() {
+#ifndef PLOTSCRIPT_NO_MMAP
+			if (begin != nullptr)
+				::munmap(const_cast<char*>(begin), length);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		[[nodiscard]] bool is_open() const noexcept { return open; }
+		[[nodiscard]] const char* data() const noexcept { return begin; }
+		[[nodiscard]] std::size_t size() const noexcept { return length; }
+
+	private:
+		const char* begin = nullptr;
+		std::size_t length = 0;
+		bool open = false;
+#ifdef PLOTSCRIPT_NO_MMAP
+		std::string contents;
+#endif
+	};
+
+	bool blank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Parses the fields of one line into row; false if a field is not a number.
+	bool parse_line(const char* first, const char* last, char delimiter, std::vector<double>& row) {
+		row.clear();
+		while (true) {
+			while (first != last && blank(*first) && *first != delimiter)
+				first++;
+			if (first != last && *first == '+')
+				first++;
+
+			double value = 0;
+			auto [end, error] = std::from_chars(first, last, value);
+			if (error != std::errc())
+				return false;
+			row.push_back(value);
+
+			first = end;
+			while (first != last && blank(*first) && *first != delimiter)
+				first++;
+			if (first == last)
+				return true;
+			if (*first != delimiter)
+				return false;
+			first++;
+		}
+	}
+
+	bool empty_line(const char* first, const char* last) {
+		return std::all_of(first, last, blank);
+	}
+
+	struct Chunk {
+		const char* begin = nullptr;
+		const char* end = nullptr;
+		Columns columns;
+		std::size_t lines = 0;
+		// line within the chunk of the first bad row, if any
+		std::optional<std::size_t> bad_line;
+	};
+
+	void parse_chunk(Chunk& chunk, char delimiter, std::size_t width) {
+		chunk.columns.assign(width, {});
+		std::vector<double> row;
+
+		const char* line = chunk.begin;
+		while (line < chunk.end) {
+			const char* newline = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+			const char* stop = newline != nullptr ? newline : chunk.end;
+
+			if (!empty_line(line, stop)) {
+				if (!parse_line(line, stop, delimiter, row) || row.size() != width) {
+					chunk.bad_line = chunk.lines;
+					return;
+				}
+				for (std::size_t c = 0; c < width; c++)
+					chunk.columns[c].push_back(row[c]);
+			}
+
+			chunk.lines++;
+			line = stop + 1;
+		}
+	}
+}
+
+Expected<Columns> read(const std::string& path) {
+
+	MappedFile file(path);
+	if (!file.is_open())
+		return Error("Error: could not open " + path + " for reading");
+
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+
+	// skip leading blank lines, then look at the first line for the layout
+	std::size_t line_number = 1;
+	const char* first_line_end = begin;
+	while (begin < end) {
+		first_line_end = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+		if (first_line_end == nullptr)
+			first_line_end = end;
+		if (!empty_line(begin, first_line_end))
+			break;
+		begin = first_line_end + 1;
+		line_number++;
+	}
+	if (begin >= end)
+		return Columns();
+
+	char delimiter = std::find(begin, first_line_end, '\t') != first_line_end ? '\t' : ',';
+	std::vector<double> row;
+	if (!parse_line(begin, first_line_end, delimiter, row)) {
+		// header: the width comes from its field count
+		row.assign(std::count(begin, first_line_end, delimiter) + 1, 0);
+		begin = first_line_end + 1;
+		line_number++;
+	}
+	std::size_t width = row.size();
+
+	// cut into chunks that start at the beginning of a line
+	ThreadPool* pool = ThreadPool::current();
+	std::size_t workers = pool != nullptr ? pool->size() + 1 : 1;
+	std::size_t bytes = begin < end ? static_cast<std::size_t>(end - begin) : 0;
+	std::size_t target = std::max(CHUNK_BYTES, bytes / (4 * workers) + 1);
+
+	std::vector<Chunk> chunks;
+	for (const char* at = begin; at < end;) {
+		const char* stop = at + std::min<std::size_t>(target, end - at);
+		if (stop < end) {
+			const char* newline = static_cast<const char*>(std::memchr(stop, '\n', end - stop));
+			stop = newline != nullptr ? newline + 1 : end;
+		}
+		Chunk chunk;
+		chunk.begin = at;
+		chunk.end = stop;
+		chunks.push_back(std::move(chunk));
+		at = stop;
+	}
+
+	auto parse = [&](std::size_t i) { parse_chunk(chunks[i], delimiter, width); };
+	if (pool != nullptr && chunks.size() > 1) {
+		pool->parallel_for(chunks.size(), parse);
+	}
+	else {
+		for (std::size_t i = 0; i < chunks.size(); i++)
+			parse(i);
+	}
+
+	std::vector<std::size_t> offsets(chunks.size() + 1, 0);
+	for (std::size_t i = 0; i < chunks.size(); i++) {
+		if (chunks[i].bad_line) {
+			return Error("Error: line " + std::to_string(line_number + *chunks[i].bad_line) + " of " + path
+				+ " does not have " + std::to_string(width) + " numeric fields");
+		}
+		line_number += chunks[i].lines;
+		offsets[i + 1] = offsets[i] + (width > 0 ? chunks[i].columns[0].size() : 0);
+	}
+
+	Columns columns(width, std::vector<double>(offsets.back()));
+	auto gather = [&](std::size_t i) {
+		for (std::size_t c = 0; c < width; c++)
+			std::copy(chunks[i].columns[c].begin(), chunks[i].columns[c].end(), columns[c].begin() + static_cast<std::ptrdiff_t>(offsets[i]));
+	};
+	if (pool != nullptr && chunks.size() > 1) {
+		pool->parallel_for(chunks.size(), gather);
+	}
+	else {
+		for (std::size_t i = 0; i < chunks.size(); i++)
+			gather(i);
+	}
+
+	return columns;
+}
+
+}
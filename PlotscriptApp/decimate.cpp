@@ -0,0 +1,165 @@
+#include "decimate.h"
+#include "graphics.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace decimate {
+
+namespace {
+
+	// Buckets handled by one task; fixed so parallel output does not depend on
+	// the size of the pool.
+	constexpr std::size_t BLOCK = 1024;
+
+	template <typename F>
+	void for_each_block(std::size_t count, bool parallel, F&& body) {
+		std::size_t blocks = (count + BLOCK - 1) / BLOCK;
+		ThreadPool* pool = parallel ? ThreadPool::current() : nullptr;
+		if (pool != nullptr && blocks > 1) {
+			pool->parallel_for(blocks, [&](std::size_t b) { body(b * BLOCK, std::min(count, (b + 1) * BLOCK)); });
+		}
+		else {
+			body(0, count);
+		}
+	}
+
+	// First point of LTTB bucket i. Bucket i covers [start(i), start(i + 1)); the
+	// first and last points of the series are kept separately.
+	std::size_t bucket_start(std::size_t i, double every, std::size_t n) {
+		return std::min(n - 1, static_cast<std::size_t>(std::floor(static_cast<double>(i) * every)) + 1);
+	}
+
+	// Picks one point from each LTTB bucket in [first, last), starting from the
+	// anchor (ax, ay).
+	void lttb_buckets(const Series& s, double every, std::size_t first, std::size_t last,
+		double ax, double ay, std::size_t* out) {
+
+		std::size_t n = s.x.size();
+
+		for (std::size_t i = first; i < last; i++) {
+			std::size_t begin = bucket_start(i, every, n), end = bucket_start(i + 1, every, n);
+			// past the last bucket only the final point remains
+			std::size_t next_end = std::max(end + 1, bucket_start(i + 2, every, n));
+
+			// the centroid of the next bucket stands in for the point chosen there
+			double cx = 0, cy = 0;
+			for (std::size_t j = end; j < next_end; j++) {
+				cx += s.x[j];
+				cy += s.y[j];
+			}
+			cx /= static_cast<double>(next_end - end);
+			cy /= static_cast<double>(next_end - end);
+
+			std::size_t best = begin;
+			double best_area = -1;
+			for (std::size_t j = begin; j < end; j++) {
+				double area = std::fabs((ax - cx) * (s.y[j] - ay) - (ax - s.x[j]) * (cy - ay));
+				if (area > best_area) {
+					best_area = area;
+					best = j;
+				}
+			}
+
+			out[i] = best;
+			ax = s.x[best];
+			ay = s.y[best];
+		}
+	}
+}
+
+std::optional<Error> read(const Expression& list, Series& series, bool parallel) {
+
+	if (list.head().toString() != "list" || list.packed())
+		return Error("Error: decimation expects a list of points");
+
+	auto items = list.tailConstBegin();
+	std::size_t n = list.tailConstEnd() - items;
+	series.x.resize(n);
+	series.y.resize(n);
+
+	std::vector<char> valid(n, 1);
+	for_each_block(n, parallel, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; i++)
+			valid[i] = point_coordinates(*(items + static_cast<std::ptrdiff_t>(i)), series.x[i], series.y[i]);
+	});
+
+	if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+		return Error("Error: decimation expects a list of points");
+	return std::nullopt;
+}
+
+std::vector<std::size_t> lttb(const Series& series, std::size_t target, bool parallel) {
+
+	std::size_t n = series.x.size();
+	std::vector<std::size_t> keep;
+	if (target >= n || target < 3) {
+		keep.resize(n);
+		for (std::size_t i = 0; i < n; i++)
+			keep[i] = i;
+		return keep;
+	}
+
+	std::size_t buckets = target - 2;
+	double every = static_cast<double>(n - 2) / static_cast<double>(buckets);
+	keep.resize(target);
+	keep.front() = 0;
+	keep.back() = n - 1;
+
+	for_each_block(buckets, parallel, [&](std::size_t first, std::size_t last) {
+		double ax = series.x[0], ay = series.y[0];
+		if (first > 0) {
+			std::size_t begin = bucket_start(first - 1, every, n), end = bucket_start(first, every, n);
+			ax = ay = 0;
+			for (std::size_t j = begin; j < end; j++) {
+				ax += series.x[j];
+				ay += series.y[j];
+			}
+			ax /= static_cast<double>(end - begin);
+			ay /= static_cast<double>(end - begin);
+		}
+		lttb_buckets(series, every, first, last, ax, ay, keep.data() + 1);
+	});
+
+	return keep;
+}
+
+std::vector<std::size_t> min_max(const Series& series, std::size_t target, bool parallel) {
+
+	std::size_t n = series.x.size();
+	std::size_t buckets = target / 2;
+	std::vector<std::size_t> keep;
+	if (target >= n || buckets == 0) {
+		keep.resize(n);
+		for (std::size_t i = 0; i < n; i++)
+			keep[i] = i;
+		return keep;
+	}
+
+	// two slots per bucket, set to n where a bucket's low and high coincide
+	std::vector<std::size_t> slots(2 * buckets);
+	for_each_block(buckets, parallel, [&](std::size_t first, std::size_t last) {
+		for (std::size_t b = first; b < last; b++) {
+			std::size_t begin = b * n / buckets, end = (b + 1) * n / buckets;
+			std::size_t low = begin, high = begin;
+			for (std::size_t j = begin + 1; j < end; j++) {
+				if (series.y[j] < series.y[low])
+					low = j;
+				if (series.y[j] > series.y[high])
+					high = j;
+			}
+			slots[2 * b] = std::min(low, high);
+			slots[2 * b + 1] = low == high ? n : std::max(low, high);
+		}
+	});
+
+	keep.reserve(slots.size());
+	for (std::size_t i : slots) {
+		if (i != n)
+			keep.push_back(i);
+	}
+	return keep;
+}
+
+}
@@ -1,36 +1,67 @@
 #include "environment.h"
+#include "budget.h"
 #include "semantic_error.h"
+#include "csv.h"
+#include "decimate.h"
+#include "graphics.h"
+#include "kernels.h"
+#include "packed.h"
+#include "spatial.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "svg.h"
+
+#include <algorithm>
+#include <optional>
+#include <type_traits>
 
 Environment::Environment() {
     reset();
 }
 
+const Environment::EnvResult* Environment::find(const Atom& sym) const
+{
+    if (!sym.isSymbol()) return nullptr;
+
+    stats::add(stats::Lookups);
+    stats::add(stats::MapFinds);
+    auto result = env.find(sym);
+    if (result != env.end())
+        return &result->second;
+
+    for (const Layer* layer = shared.get(); layer != nullptr; layer = layer->parent.get()) {
+        stats::add(stats::MapFinds);
+        auto found = layer->bindings.find(sym);
+        if (found != layer->bindings.end())
+            return &found->second;
+    }
+    return nullptr;
+}
+
+const builtins::Builtin* Environment::builtin(const Atom& sym) const {
+    if (!sym.isSymbol()) return nullptr;
+    stats::add(stats::Lookups);
+    return builtins::find(sym.asSymbol());
+}
+
 bool Environment::is_known(const Atom& sym) const
 {   
-    if (!sym.isSymbol()) return false;
-    return env.find(sym) != env.end();
+    return find(sym) != nullptr || builtin(sym) != nullptr;
 }
 
 bool Environment::is_exp(const Atom& sym) const {
-    if (!sym.isSymbol()) return false;
-
-    auto result = env.find(sym);
-    return (result != env.end()) && (result->second.type == ExpressionType);
+    const EnvResult* result = find(sym);
+    return result != nullptr;
 }
 
 bool Environment::is_proc(const Atom& sym) const {
-    if (!sym.isSymbol()) return false;
-
-    auto result = env.find(sym);
-    return (result != env.end()) && (result->second.type == ProcedureType);
+    return builtin(sym) != nullptr;
 }
 
 bool Environment::is_lambda(const Atom& sym) const {
-    if (!sym.isSymbol()) return false;
-
-    auto result = env.find(sym);
-    if (result != env.end()) {
-        return result->second.exp.head().toString() == "lambda";
+    const EnvResult* result = find(sym);
+    if (result != nullptr) {
+        return result->exp.head().toString() == "lambda";
     }
 
     return false;
@@ -38,296 +69,471 @@ bool Environment::is_lambda(const Atom& sym) const {
 
 Expression Environment::get_exp(const Atom& sym) const {
 
-    if (sym.isSymbol()) {
-        auto result = env.find(sym);
-        if ((result != env.end()) && (result->second.type == ExpressionType)) {
-            return result->second.exp;
-        }
+    const EnvResult* result = find(sym);
+    if (result != nullptr) {
+        return result->exp;
     }
 
     return {};
 }
 
-void Environment::add_exp(const Atom& sym, const Expression& value) {
+std::optional<Error> Environment::try_add_exp(const Atom& sym, const Expression& value) {
 
     if (!sym.isSymbol()) {
-        throw SemanticError("Error: during add_exp: Attempt to add non-symbol to environment");
+        return Error("Error: during add_exp: Attempt to add non-symbol to environment");
     }
 
     std::string s = sym.asSymbol();
     if ((s == "define") || (s == "begin") || (s == "lambda") || (s == "list")) {
-        throw SemanticError("Error during add_exp: attempt to redefine a special-form");
+        return Error("Error during add_exp: attempt to redefine a special-form");
     }
     
     if (is_proc(sym)) {
-        throw SemanticError("Error during add_exp: attempt to redefine a built-in procedure");
+        return Error("Error during add_exp: attempt to redefine a built-in procedure");
     }
 
     if (env.find(sym) != env.end())
         env.erase(sym);
 
-    env.emplace(sym, EnvResult(ExpressionType, value));
+    env.emplace(sym, EnvResult(value));
+    return std::nullopt;
 }
 
-Expression nop(const std::vector<Expression>& args) {
+void Environment::add_exp(const Atom& sym, const Expression& value) {
+
+    if (auto error = try_add_exp(sym, value))
+        throw SemanticError(error->message());
+}
+
+Result nop(Arguments args) {
     (void) args.size();
     return {};
 }
 
 Procedure Environment::get_proc(const Atom& sym) const {
 
-    if (sym.isSymbol()) {
-        auto result = env.find(sym);
-        if ((result != env.end()) && (result->second.type == ProcedureType)) {
-            return result->second.proc;
-        }
+    const builtins::Builtin* result = builtin(sym);
+    if (result != nullptr) {
+        return result->proc;
     }
 
     return (Procedure) nop;
 }
 
-Expression add(const std::vector<Expression>& args) {
-
-    double result = 0;
-    double complex_part = 0;
-
-    for (auto& a : args) {
-        Atom operand = a.head();
-        std::complex<double> term = operand.asComplex();
-
-        result += term.real();
-        if (term.imag() != 0) {
-            complex_part += term.imag();
+Environment Environment::fork() {
+
+    if (!env.empty()) {
+        auto layer = std::make_shared<Layer>();
+        layer->bindings = std::move(env);
+        layer->parent = std::move(shared);
+
+        // Fold in every parent layer no larger than the new one, as a binary
+        // counter carries, so a chain of n bindings is at most log2(n) layers
+        // deep and each binding is copied O(log n) times over all forks. The
+        // builtin constants at the root stay shared.
+        while (layer->parent->parent != nullptr && layer->parent->bindings.size() <= layer->bindings.size()) {
+            // insert keeps the newer binding of a name defined in both
+            layer->bindings.insert(layer->parent->bindings.begin(), layer->parent->bindings.end());
+            layer->parent = layer->parent->parent;
         }
+
+        shared = std::move(layer);
+        env.clear();
     }
 
+    return *this;
+}
 
-    return { std::complex<double>(result, complex_part) };
+bool is_list(const Expression& exp) {
+    return exp.head().toString() == "list";
 }
 
-Expression sub_neg(const std::vector<Expression>& args) {
+// (op list list) applies op pairwise; numeric lists go through one kernel call,
+// anything else falls back to calling the scalar builtin once per pair.
+Result elementwise(kernels::BinaryOp op, BinaryProcedure scalar, const Expression& left, const Expression& right) {
 
-    if (args.size() != 1 && args.size() != 2) {
-        throw SemanticError("Error: in call to sub_neg: invalid number of arguments.");
-    }
+    if (!is_list(left) || !is_list(right))
+        return Error("Error: element-wise arithmetic requires two lists");
 
-    double r = args[0].head().asNumber();
-    double i = args[0].head().asComplex().imag();
+    std::vector<double> a, b;
+    bool numeric = kernels::as_numbers(left, a) && kernels::as_numbers(right, b);
+    if (numeric && a.size() != b.size())
+        return Error("Error: element-wise arithmetic on lists of different length");
 
-    if (args.size() == 1) {
+    if (numeric && (op != kernels::BinaryOp::Div || std::find(b.begin(), b.end(), 0.0) == b.end())) {
+        kernels::binary(op, a.data(), b.data(), a.data(), a.size());
+        return kernels::to_list(std::move(a));
+    }
 
-        if (i == 0) {
-            return { -r };
-        }
-        else
-            return { -std::complex<double>(r, i) };
+    if (left.itemCount() != right.itemCount())
+        return Error("Error: element-wise arithmetic on lists of different length");
+
+    std::vector<Expression> items;
+    items.reserve(left.itemCount());
+    for (std::size_t i = 0; i < left.itemCount(); i++) {
+        Result item = scalar(left.item(i), right.item(i));
+        if (!item)
+            return item;
+        items.push_back(std::move(item).value());
     }
 
-    std::complex<double> result; 
-    result = args[0].head().asComplex() - args[1].head().asComplex();
+    return { Atom("list"), items };
+}
 
-    return { result };
+bool is_elementwise(const Expression& left, const Expression& right) {
+    return is_list(left) || is_list(right);
 }
 
-Expression mul(const std::vector<Expression>& args) {
+// The arithmetic builtins are written once over the value type T. The double
+// instantiation serves real-only arguments; std::complex<double> is used only
+// when an operand is complex, or when the real result is not finite, since the
+// complex form is what decides the imaginary part of inf and nan results.
+template <typename T>
+T operand(const Expression& e) {
+    if constexpr (std::is_same_v<T, double>)
+        return e.head().asNumber();
+    else
+        return e.head().asComplex();
+}
 
-    std::complex<double> result(1, 0);
+bool all_real(Arguments args) {
+    return std::none_of(args.begin(), args.end(), [](const Expression& e) { return e.head().isComplex(); });
+}
 
-    for (auto& a : args) {
-        Atom operand = a.head();
-        if (!operand.isComplex() && !operand.isNumber()) {
-            throw SemanticError("Error: in call to mul: argument was not a number type.");
+struct Sum {
+    template <typename T>
+    static T compute(Arguments args) {
+        T result = 0;
+        for (auto& a : args)
+            result += operand<T>(a);
+        return result;
+    }
 
-        }
-        result *= operand.asComplex();
+    template <typename T>
+    static T compute(const Expression& left, const Expression& right) {
+        T result = 0;
+        result += operand<T>(left);
+        result += operand<T>(right);
+        return result;
+    }
+};
+
+struct Difference {
+    template <typename T>
+    static T compute(Arguments args) {
+        if (args.size() == 1)
+            return -operand<T>(args[0]);
+        return compute<T>(args[0], args[1]);
     }
-    
-    return { result };
-}
 
-Expression div(const std::vector<Expression>& args) {
+    template <typename T>
+    static T compute(const Expression& left, const Expression& right) {
+        return operand<T>(left) - operand<T>(right);
+    }
+};
+
+struct Product {
+    template <typename T>
+    static T compute(Arguments args) {
+        T result = 1;
+        for (auto& a : args)
+            result *= operand<T>(a);
+        return result;
+    }
 
-    std::complex<double> result, first, second;
+    template <typename T>
+    static T compute(const Expression& left, const Expression& right) {
+        T result = 1;
+        result *= operand<T>(left);
+        result *= operand<T>(right);
+        return result;
+    }
+};
+
+struct Quotient {
+    template <typename T>
+    static T compute(Arguments args) {
+        if (args.size() == 1)
+            return T(1) / operand<T>(args[0]);
+        return compute<T>(args[0], args[1]);
+    }
 
-    if (args.size() == 1) {
-        result = std::complex<double>(1, 0) / args[0].head().asComplex();
+    template <typename T>
+    static T compute(const Expression& left, const Expression& right) {
+        return operand<T>(left) / operand<T>(right);
     }
-    else if (args.size() == 2) {
-        second = args[1].head().asComplex();
-        first = args[0].head().asComplex();
-        result = first / second;
-        if (second.real() == 0 && std::isnan(result.real()))
-            throw SemanticError("Error: div by zero");
+};
+
+template <typename Op>
+Expression arithmetic(Arguments args) {
+    if (all_real(args)) {
+        double result = Op::template compute<double>(args);
+        if (std::isfinite(result))
+            return { result };
     }
-    else {
-        throw SemanticError("Error: in call to div: invalid number of arguments.");
+    return { Op::template compute<std::complex<double>>(args) };
+}
+
+template <typename Op>
+Expression arithmetic(const Expression& left, const Expression& right) {
+    if (!left.head().isComplex() && !right.head().isComplex()) {
+        double result = Op::template compute<double>(left, right);
+        if (std::isfinite(result))
+            return { result };
     }
+    return { Op::template compute<std::complex<double>>(left, right) };
+}
 
-    return { result };
+// The arithmetic builtins have a binary form for the common two-argument call;
+// the span form handles every other arity and defers to it for two.
+Result add(const Expression& left, const Expression& right) {
+
+    if (is_elementwise(left, right))
+        return elementwise(kernels::BinaryOp::Add, add, left, right);
+
+    return arithmetic<Sum>(left, right);
 }
 
-Expression root(const std::vector<Expression>& args) {
+Result add(Arguments args) {
 
-    std::complex<double> result, first = args[0].head().asComplex();
+    if (args.size() == 2)
+        return add(args[0], args[1]);
 
-    if (args.size() == 1) {
-        result = std::sqrt(first);
-    }
-    else {
-        throw SemanticError("Error: in call to sqrt: invalid number of arguments.");
-    }
-    return { result };
+    return arithmetic<Sum>(args);
 }
 
-Expression pow(const std::vector<Expression>& args) {
+Result sub_neg(const Expression& left, const Expression& right) {
 
-    std::complex<double> result, first, second;
+    if (is_elementwise(left, right))
+        return elementwise(kernels::BinaryOp::Sub, sub_neg, left, right);
 
-    first = args[0].head().asComplex();
-    second = args[1].head().asComplex();
+    return arithmetic<Difference>(left, right);
+}
 
-    if (args.size() == 2) {
-        result = std::pow(first, second);
-    }
-    else {
-        throw SemanticError("Error: in call to pow: invalid number of arguments.");
+Result sub_neg(Arguments args) {
+
+    if (args.size() == 2)
+        return sub_neg(args[0], args[1]);
+
+    return arithmetic<Difference>(args);
+}
+
+bool is_number(const Expression& e) {
+    return e.head().isComplex() || e.head().isNumber();
+}
+
+Result mul(const Expression& left, const Expression& right) {
+
+    if (is_elementwise(left, right))
+        return elementwise(kernels::BinaryOp::Mul, mul, left, right);
+
+    if (!is_number(left) || !is_number(right))
+        return Error("Error: in call to mul: argument was not a number type.");
+
+    return arithmetic<Product>(left, right);
+}
+
+Result mul(Arguments args) {
+
+    if (args.size() == 2)
+        return mul(args[0], args[1]);
+
+    if (!std::all_of(args.begin(), args.end(), is_number))
+        return Error("Error: in call to mul: argument was not a number type.");
+
+    return arithmetic<Product>(args);
+}
+
+Result div(const Expression& left, const Expression& right) {
+
+    if (is_elementwise(left, right))
+        return elementwise(kernels::BinaryOp::Div, div, left, right);
+
+    // a zero divisor always gives a non-finite real result and lands below
+    Expression result = arithmetic<Quotient>(left, right);
+
+    if (right.head().asComplex().real() == 0 && std::isnan(result.head().asNumber()))
+        return Error("Error: div by zero");
+
+    return result;
+}
+
+Result div(Arguments args) {
+
+    if (args.size() == 2)
+        return div(args[0], args[1]);
+
+    return arithmetic<Quotient>(args);
+}
+
+Result root(const Expression& arg) {
+
+    Atom first = arg.head();
+    if (!first.isComplex() && first.asNumber() >= 0)
+        return { std::sqrt(first.asNumber()) };
+
+    return { std::sqrt(first.asComplex()) };
+}
+
+Result pow(const Expression& base, const Expression& exponent) {
+
+    // a non-positive real base can still produce a complex result
+    if (!base.head().isComplex() && !exponent.head().isComplex() && operand<double>(base) > 0) {
+        double result = std::pow(operand<double>(base), operand<double>(exponent));
+        if (std::isfinite(result))
+            return { result };
     }
-    return { result };
+
+    return { std::pow(operand<std::complex<double>>(base), operand<std::complex<double>>(exponent)) };
 }
 
-Expression ln(const std::vector<Expression>& args) {
+Result ln(const Expression& arg) {
 
     std::complex<double> result, first;
-    first = args[0].head().asNumber();
+    first = arg.head().asNumber();
     if (first.real() < 0)
-        throw SemanticError("Error: negative argument to ln");
+        return Error("Error: negative argument to ln");
 
-    if (args.size() == 1) {
-        result = std::log(first);
-    }
-    else {
-        throw SemanticError("Error: in call to ln: invalid number of arguments.");
-    }
+    result = std::log(first);
     return { result };
 }
 
-Expression log(const std::vector<Expression>& args) {
+Result log(Arguments args) {
 
     std::complex<double> result, first, second;
     first = args[0].head().asNumber();
 
     if (first.real() < 0)
-        throw SemanticError("Error: negative argument to log");
+        return Error("Error: negative argument to log");
 
     if (args.size() == 1) {
         result = std::log10(first);
     }
-    else if (args.size() == 2) {
+    else {
         second = args[1].head().asNumber();
         result = std::log(first) / std::log(second);
     }
-    else {
-        throw SemanticError("Error: in call to log: invalid number of arguments.");
-    }
     return { result };
 }
 
-Expression sin(const std::vector<Expression>& args) {
+Result sin(const Expression& arg) {
 
     std::complex<double> result, first;
-    first = args[0].head().asNumber();
+    first = arg.head().asNumber();
 
-    if (args.size() == 1) {
-        result = std::sin(first);
-    }
-    else {
-        throw SemanticError("Error: in call to sin: invalid number of arguments.");
-    }
+    result = std::sin(first);
     return { result };
 }
 
-Expression cos(const std::vector<Expression>& args) {
+Result cos(const Expression& arg) {
 
     std::complex<double> result, first;
-    first = args[0].head().asNumber();
+    first = arg.head().asNumber();
 
-    if (args.size() == 1) {
-        result = std::cos(first);
-    }
-    else {
-        throw SemanticError("Error: in call to cos: invalid number of arguments.");
-    }
+    result = std::cos(first);
     return { result };
 }
 
-Expression tan(const std::vector<Expression>& args) {
+Result tan(const Expression& arg) {
 
     std::complex<double> result, first;
-    first = args[0].head().asNumber();
+    first = arg.head().asNumber();
 
-    if (args.size() == 1) {
-        result = std::tan(first);
-    }
-    else {
-        throw SemanticError("Error: in call to tan: invalid number of arguments.");
-    }
+    result = std::tan(first);
     return { result };
 }
 
-Expression real(const std::vector<Expression>& args) {
+Result real(const Expression& arg) {
 
     double result;
-    Atom a = args[0].head();
+    Atom a = arg.head();
     if (!a.isComplex())
-        throw SemanticError("Error: argument to real was not a complex number");
+        return Error("Error: argument to real was not a complex number");
 
     result = a.asNumber();
     return { result };
 }
 
-Expression imag(const std::vector<Expression>& args) {
+Result imag(const Expression& arg) {
 
     double result;
-    Atom a = args[0].head();
+    Atom a = arg.head();
     if (!a.isComplex())
-        throw SemanticError("Error: argument to imag was not a complex number");
+        return Error("Error: argument to imag was not a complex number");
 
     result = a.asComplex().imag();
     return { result };
 }
 
-Expression list(const std::vector<Expression>& items) {
+Result list(Arguments items) {
 
-    return { Atom("list"), items };
+    if (auto packed = NumericVector::pack(items))
+        return Expression(packed);
+
+    return { Atom("list"), std::vector<Expression>(items.begin(), items.end()) };
 }
 
-Expression first(const std::vector<Expression>& args) {
+// Accumulates numbers for a packed list, switching to complex storage on demand.
+class PackedBuilder {
+public:
+    void add(const NumericVector& v, std::size_t from = 0) {
+        if (v.isComplex())
+            make_complex();
+
+        real.insert(real.end(), v.reals().begin() + from, v.reals().end());
+        if (v.isComplex())
+            imag.insert(imag.end(), v.imags().begin() + from, v.imags().end());
+        else if (complex)
+            imag.resize(real.size(), 0);
+    }
 
-    if (args.size() != 1)
-        throw SemanticError("Error: more than one argument in call to first.");
+    void add(const Atom& a) {
+        if (a.isComplex())
+            make_complex();
 
-    const Expression& list = args[0];
-  
-    if (list.head().toString() != "list")
-        throw SemanticError("Error: argument to first was not a list");
+        real.push_back(a.asNumber());
+        if (complex)
+            imag.push_back(a.asComplex().imag());
+    }
 
-    if (list.tailConstBegin() == list.tailConstEnd())
-        throw SemanticError("Error: argument to first was empty list");
-    
-    return { *args[0].tailConstBegin() };
-}
+    Expression build() {
+        if (real.empty())
+            return { Atom("list"), {} };
+        if (complex)
+            return Expression(std::make_shared<const NumericVector>(std::move(real), std::move(imag)));
+        return Expression(std::make_shared<const NumericVector>(std::move(real)));
+    }
 
-Expression rest(const std::vector<Expression>& args) {
-    if (args.size() > 1)
-        throw SemanticError("Error: more than one argument in call to rest.");
+private:
+    void make_complex() {
+        if (!complex) {
+            complex = true;
+            imag.resize(real.size(), 0);
+        }
+    }
+
+    std::vector<double> real;
+    std::vector<double> imag;
+    bool complex = false;
+};
 
-    const Expression& list = args[0];
+Result first(const Expression& list) {
 
-    if (list.head().toString() != "list")
-        throw SemanticError("Error: argument to rest was not a list");
+    if (list.itemCount() == 0)
+        return Error("Error: argument to first was empty list");
+
+    return { list.item(0) };
+}
 
-    if (list.tailConstBegin() == list.tailConstEnd())
-        throw SemanticError("Error: argument to rest was empty list");
+Result rest(const Expression& list) {
+    if (list.itemCount() == 0)
+        return Error("Error: argument to rest was empty list");
+
+    if (const NumericVector* packed = list.packed()) {
+        PackedBuilder items;
+        items.add(*packed, 1);
+        return items.build();
+    }
 
     std::vector<Expression> items;
     for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); it++) {
@@ -339,14 +545,9 @@ Expression rest(const std::vector<Expression>& args) {
     return { Atom("list"), items };
 }
 
-Expression length(const std::vector<Expression>& args) {
-    if (args.size() > 1)
-        throw SemanticError("Error: more than one argument in call to length.");
-
-    const Expression& list = args[0];
-
-    if (list.head().toString() != "list")
-        throw SemanticError("Error: argument to length was not a list");
+Result length(const Expression& list) {
+    if (const NumericVector* packed = list.packed())
+        return { Atom(static_cast<double>(packed->size())) };
 
     int len = 0;
     for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); it++)
@@ -355,85 +556,246 @@ Expression length(const std::vector<Expression>& args) {
     return { Atom(len) };
 }
 
-Expression append(const std::vector<Expression>& args) {
-    if (args.size() != 2)
-        throw SemanticError("Error: not given 2 arguments to append.");
+Result append(const Expression& list, const Expression& item) {
 
-    const Expression& list = args[0];
-
-    if (list.head().toString() != "list")
-        throw SemanticError("Error: first argument to append was not a list");
+    if (const NumericVector* packed = list.packed()) {
+        if (item.isPlainNumber()) {
+            PackedBuilder items;
+            items.add(*packed);
+            items.add(item.head());
+            return items.build();
+        }
+    }
 
     std::vector<Expression> items;
-    for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); it++) {
-        items.push_back(*it);
-    }
-    items.push_back(args[1]);
+    items.reserve(list.itemCount() + 1);
+    for (std::size_t i = 0; i < list.itemCount(); i++)
+        items.push_back(list.item(i));
+    items.push_back(item);
 
     return { Atom("list"), items };
 }
 
-Expression join(const std::vector<Expression>& args) {
+Result join(Arguments args) {
+
+    for (const auto& arg : args) {
+        if (arg.head().toString() != "list")
+            return Error("Error: argument to join not a list");
+    }
+
+    std::size_t total = 0;
+    for (const auto& arg : args)
+        total += arg.itemCount();
+    if (auto halt = Budget::charge(total))
+        return *halt;
+
+    auto packed_or_empty = [](const Expression& arg) {
+        return arg.packed() || arg.itemCount() == 0;
+    };
+    if (std::all_of(args.begin(), args.end(), packed_or_empty)) {
+        bool complex = std::any_of(args.begin(), args.end(), [](const Expression& arg) {
+            return arg.packed() && arg.packed()->isComplex();
+        });
+        if (auto error = Budget::reserve(total * (complex ? 2 : 1) * sizeof(double)))
+            return *error;
+
+        PackedBuilder items;
+        for (const auto& arg : args) {
+            if (arg.packed())
+                items.add(*arg.packed());
+        }
+        return items.build();
+    }
 
-    if (args.empty())
-        throw SemanticError("Error: nothing to join");
+    if (auto error = Budget::reserve(total * sizeof(Expression)))
+        return *error;
 
     std::vector<Expression> items;
+    items.reserve(total);
 
     for (const auto& arg : args) {
-        if (arg.head().toString() != "list")
-            throw SemanticError("Error: argument to join not a list");
-        for (auto it = arg.tailConstBegin(); it != arg.tailConstEnd(); it++) {
-            items.push_back(*it);
-        }
+        for (std::size_t i = 0; i < arg.itemCount(); i++)
+            items.push_back(arg.item(i));
     }
 
     return { Atom("list"), items };
 }
 
-Expression range(const std::vector<Expression>& args) {
+Result range(Arguments args) {
     double start, stop, step;
 
-    if (args.size() < 2)
-        throw SemanticError("Error: number of args to range");
-
-    for (const auto& arg : args) {
-        if (!arg.head().isNumber())
-            throw SemanticError("Error: argument to range was not a number");
-    }
-
     start = args[0].head().asNumber();
     stop = args[1].head().asNumber();
 
     if (start > stop)
-        throw SemanticError("Error: begin greater than end in range");
+        return Error("Error: begin greater than end in range");
 
     if (args.size() == 3) {
         step = args[2].head().asNumber();
         if (step <= 0)
-            throw SemanticError("Error: negative or zero increment in range");
+            return Error("Error: negative or zero increment in range");
     }
     else
         step = 1;
 
-    std::vector<Expression> items;
-    int steps = static_cast<int>((stop - start) / step);
+    // checked before allocating, so an oversized range fails without trying
+    double count = std::floor((stop - start) / step) + 1;
+    if (auto error = Budget::reserve(static_cast<std::size_t>(std::min(count, 1e18)) * sizeof(double)))
+        return *error;
+
+    std::vector<double> items;
+    auto steps = static_cast<std::size_t>(count) - 1;
+    items.reserve(steps + 1);
 
-    for (int i = 0; i <= steps; i++) {
-        double part = start + static_cast<double>(i) * (stop - start) / static_cast<double>(steps);
-        items.emplace_back(Expression(part));
+    for (std::size_t i = 0; i <= steps; i++) {
+        if (i % Budget::BLOCK == 0) {
+            if (auto halt = Budget::charge(std::min(Budget::BLOCK, steps + 1 - i)))
+                return *halt;
+        }
+        // steps is 0 when start == stop, and the list is just start
+        double part = steps == 0 ? start : start + static_cast<double>(i) * (stop - start) / static_cast<double>(steps);
+        items.push_back(part);
     }
 
-    return { Atom("list"), items };
+    return Expression(std::make_shared<const NumericVector>(std::move(items)));
+}
+
+// Lists at least this long are reduced in parallel chunks on the current pool.
+const std::size_t parallel_reduce_threshold = 1 << 16;
+
+// The real and imaginary parts of a single numeric list argument. Packed lists
+// are read in place, generic lists are copied out once.
+class NumericArgument {
+public:
+    NumericArgument(Arguments args, const std::string& name) {
+        const Expression& list = args[0];
+        if (const NumericVector* packed = list.packed()) {
+            real = packed->reals().data();
+            imag = packed->isComplex() ? packed->imags().data() : nullptr;
+            size = packed->size();
+            return;
+        }
+
+        bool complex = false;
+        for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); it++) {
+            if (!it->isPlainNumber()) {
+                error = Error("Error: argument to " + name + " was not a list of numbers");
+                return;
+            }
+            real_store.push_back(it->head().asNumber());
+            imag_store.push_back(it->head().asComplex().imag());
+            complex = complex || it->head().isComplex();
+        }
+
+        real = real_store.data();
+        imag = complex ? imag_store.data() : nullptr;
+        size = real_store.size();
+    }
+
+    std::optional<Error> error;
+    const double* real = nullptr;
+    const double* imag = nullptr;
+    std::size_t size = 0;
+
+private:
+    std::vector<double> real_store;
+    std::vector<double> imag_store;
+};
+
+// Reduces [0, n) with part, split into one chunk per pool thread when the list
+// is long enough, and joins the partial results in order.
+template <typename T, typename Part, typename Join>
+T reduce_chunks(std::size_t n, Part part, Join join) {
+
+    ThreadPool* pool = ThreadPool::current();
+    if (pool == nullptr || pool->size() == 0 || n < parallel_reduce_threshold)
+        return part(0, n);
+
+    std::size_t width = (n + pool->size()) / (pool->size() + 1);
+    std::size_t chunks = (n + width - 1) / width;
+    std::vector<T> partials(chunks);
+
+    pool->parallel_for(chunks, [&](std::size_t c) {
+        partials[c] = part(c * width, std::min(n, (c + 1) * width));
+    });
+
+    T result = partials[0];
+    for (std::size_t c = 1; c < chunks; c++)
+        result = join(result, partials[c]);
+    return result;
+}
+
+kernels::Accumulator compensated_sum(const double* values, std::size_t n) {
+    return reduce_chunks<kernels::Accumulator>(n,
+        [values](std::size_t begin, std::size_t end) { return kernels::sum(values + begin, end - begin); },
+        [](kernels::Accumulator a, const kernels::Accumulator& b) { a.add(b); return a; });
+}
+
+std::complex<double> sum_of(const NumericArgument& list) {
+    double real = compensated_sum(list.real, list.size).value();
+    double imag = list.imag ? compensated_sum(list.imag, list.size).value() : 0;
+    return { real, imag };
+}
+
+Result sum(Arguments args) {
+    NumericArgument list(args, "sum");
+    if (list.error)
+        return *list.error;
+    return { sum_of(list) };
+}
+
+Result mean(Arguments args) {
+    NumericArgument list(args, "mean");
+    if (list.error)
+        return *list.error;
+    if (list.size == 0)
+        return Error("Error: argument to mean was empty list");
+
+    return { sum_of(list) / static_cast<double>(list.size) };
+}
+
+Result product(Arguments args) {
+    NumericArgument list(args, "product");
+    if (list.error)
+        return *list.error;
+
+    // kept sequential so the result matches (* ...) bit for bit
+    if (list.imag) {
+        std::complex<double> result(1, 0);
+        for (std::size_t i = 0; i < list.size; i++)
+            result *= std::complex<double>(list.real[i], list.imag[i]);
+        return { result };
+    }
+
+    return { kernels::product(list.real, list.size) };
 }
 
-Expression set_prop(const std::vector<Expression>& args) {
-    if (args.size() != 3)
-        throw SemanticError("Error: not given 3 args to set-property");
+Result extreme(Arguments args, const std::string& name, bool minimum) {
+    NumericArgument list(args, name);
+    if (list.error)
+        return *list.error;
+    if (list.size == 0)
+        return Error("Error: argument to " + name + " was empty list");
+    if (list.imag)
+        return Error("Error: argument to " + name + " contains complex numbers");
+
+    const double* values = list.real;
+    return { reduce_chunks<double>(list.size,
+        [values, minimum](std::size_t begin, std::size_t end) {
+            return minimum ? kernels::min(values + begin, end - begin) : kernels::max(values + begin, end - begin);
+        },
+        [minimum](double a, double b) { return minimum ? std::min(a, b) : std::max(a, b); }) };
+}
 
-    if (!args[0].head().isString())
-        throw SemanticError("Error: first argument to set-property was not a string");
+Result min(Arguments args) {
+    return extreme(args, "min", true);
+}
 
+Result max(Arguments args) {
+    return extreme(args, "max", false);
+}
+
+Result set_prop(Arguments args) {
     std::string key = args[0].head().toString();
     const Expression& value = args[1];
     
@@ -443,56 +805,383 @@ Expression set_prop(const std::vector<Expression>& args) {
     return result;
 }
 
-Expression get_prop(const std::vector<Expression>& args) {
-    if (args.size() != 2)
-        throw SemanticError("Error: not given 2 args to get-property");
+Result get_prop(Arguments args) {
+    const Expression* value = args[1].findProperty(args[0].head().toString());
 
-    if (!args[0].head().isString())
-        throw SemanticError("Error: first argument to get-property was not a string");
+    return value ? *value : Expression();
+}
 
-    std::string key = args[0].head().toString();
-    Expression obj = args[1];
-    
-    return obj.getProperty(key);
+
+Result point(Arguments args) {
+    return make_point(args[0].head(), args[1].head());
+}
+
+Result line(Arguments args) {
+    return make_line(args[0], args[1]);
+}
+
+Result text(Arguments args) {
+    return make_text(args[0]);
+}
+
+Result write_svg(Arguments args) {
+    std::string path = args[0].head().asSymbol();
+    path = path.substr(1, path.size() - 2);
+
+    SvgWriter svg(path);
+    if (!svg.is_open())
+        return Error("Error: could not open " + path + " for writing");
+
+    auto written = svg.write(args[1]);
+    if (!written)
+        return written.error();
+    return { Atom(static_cast<double>(*written)) };
+}
+
+Result spatial_index(Arguments args) {
+    auto index = SpatialIndex::build(args[0]);
+    if (!index)
+        return index.error();
+
+    return Expression(std::shared_ptr<const NativeObject>(std::move(index).value()));
+}
+
+// The spatial index a query was given, nullptr for any other native object.
+const SpatialIndex* index_arguments(Arguments args) {
+    return dynamic_cast<const SpatialIndex*>(args[0].native());
+}
+
+Result query_rect(Arguments args) {
+    const SpatialIndex* index = index_arguments(args);
+    if (index == nullptr)
+        return Error("Error: first argument to query-rect was not a spatial index");
+
+    double x0 = args[1].head().asNumber(), y0 = args[2].head().asNumber();
+    double x1 = args[3].head().asNumber(), y1 = args[4].head().asNumber();
+    SpatialIndex::Box rect{ std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1) };
+
+    return { Atom("list"), index->query(rect) };
+}
+
+Result nearest(Arguments args) {
+    const SpatialIndex* index = index_arguments(args);
+    if (index == nullptr)
+        return Error("Error: first argument to nearest was not a spatial index");
+
+    double k = args[3].head().asNumber();
+    if (k < 0 || k != std::floor(k))
+        return Error("Error: count given to nearest was not a non-negative integer");
+
+    return { Atom("list"), index->nearest(args[1].head().asNumber(), args[2].head().asNumber(), static_cast<std::size_t>(k)) };
+}
+
+// Opens the file named by a string argument and loads its numeric columns.
+Expected<csv::Columns> csv_argument(Arguments args) {
+    std::string path = args[0].head().asSymbol();
+    return csv::read(path.substr(1, path.size() - 2));
+}
+
+Result read_csv(Arguments args) {
+    auto columns = csv_argument(args);
+    if (!columns)
+        return columns.error();
+
+    std::vector<Expression> lists;
+    for (auto& column : *columns)
+        lists.push_back(kernels::to_list(std::move(column)));
+    return { Atom("list"), lists };
+}
+
+Result read_csv_points(Arguments args) {
+    auto columns = csv_argument(args);
+    if (!columns)
+        return columns.error();
+
+    if (columns->size() < 2)
+        return Error("Error: read-csv-points needs at least two columns");
+
+    const std::vector<double>& xs = (*columns)[0];
+    const std::vector<double>& ys = (*columns)[1];
+    std::vector<Expression> points(xs.size());
+    reduce_chunks<bool>(xs.size(),
+        [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++)
+                points[i] = make_point(xs[i], ys[i]);
+            return true;
+        },
+        [](bool a, bool b) { return a && b; });
+
+    return { Atom("list"), points };
+}
+
+Result decimation(Arguments args, const std::string& name, bool lttb, bool parallel) {
+    double target = args[1].head().asNumber();
+    double minimum = lttb ? 3 : 2;
+    if (target < minimum || target != std::floor(target))
+        return Error("Error: target count given to " + name + " was not an integer of at least " + (lttb ? "3" : "2"));
+
+    decimate::Series series;
+    if (auto error = decimate::read(args[0], series, parallel))
+        return *error;
+
+    std::size_t count = static_cast<std::size_t>(target);
+    std::vector<std::size_t> keep = lttb ? decimate::lttb(series, count, parallel) : decimate::min_max(series, count, parallel);
+
+    // hand back the original objects so their properties survive
+    std::vector<Expression> items;
+    items.reserve(keep.size());
+    for (std::size_t i : keep)
+        items.push_back(args[0].item(i));
+    return { Atom("list"), items };
+}
+
+Result decimate_lttb(Arguments args) {
+    return decimation(args, "decimate-lttb", true, false);
+}
+
+Result pdecimate_lttb(Arguments args) {
+    return decimation(args, "pdecimate-lttb", true, true);
+}
+
+Result decimate_min_max(Arguments args) {
+    return decimation(args, "decimate-min-max", false, false);
+}
+
+Result pdecimate_min_max(Arguments args) {
+    return decimation(args, "pdecimate-min-max", false, true);
+}
+
+// The counters in stats::NAMES order, each also set as a property under its name.
+Expression stats_list(const stats::Snapshot& snapshot) {
+    std::vector<double> values(snapshot.values.begin(), snapshot.values.end());
+    Expression result = kernels::to_list(std::move(values));
+    for (std::size_t i = 0; i < stats::COUNT; i++) {
+        std::string name = "\"" + std::string(stats::NAMES[i]) + "\"";
+        result.setProperty(name, Expression(static_cast<double>(snapshot.values[i])));
+    }
+    return result;
+}
+
+Result runtime_stats(Arguments args) {
+    (void) args.size();
+    return stats_list(stats::read());
+}
+
+// Returns the counters as they were before zeroing them.
+Result reset_runtime_stats(Arguments args) {
+    (void) args.size();
+    Expression before = stats_list(stats::read());
+    stats::reset();
+    return before;
 }
 
 
 void Environment::reset()
 {
     env.clear();
+    shared = builtins();
+}
 
-    env.emplace(Atom("pi"), EnvResult(ExpressionType, Expression(std::atan2(0, -1))));
-    env.emplace(Atom("e"), EnvResult(ExpressionType, Expression(std::exp(1))));
-    env.emplace(Atom("I"), EnvResult(ExpressionType, Expression(std::complex<double>(0, 1))));
-    env.emplace(Atom("-I"), EnvResult(ExpressionType, Expression(std::complex<double>(0, -1))));
-
-    env.emplace(Atom("+"), EnvResult(ProcedureType, add));
-    env.emplace(Atom("-"), EnvResult(ProcedureType, sub_neg));
-    env.emplace(Atom("*"), EnvResult(ProcedureType, mul));
-    env.emplace(Atom("/"), EnvResult(ProcedureType, div));
-
-    env.emplace(Atom("sqrt"), EnvResult(ProcedureType, root));
-    env.emplace(Atom("^"), EnvResult(ProcedureType, pow));
-    env.emplace(Atom("pow"), EnvResult(ProcedureType, pow));
-    env.emplace(Atom("ln"), EnvResult(ProcedureType, ln));
-    env.emplace(Atom("log"), EnvResult(ProcedureType, log));
-    env.emplace(Atom("sin"), EnvResult(ProcedureType, sin));
-    env.emplace(Atom("cos"), EnvResult(ProcedureType, cos));
-    env.emplace(Atom("tan"), EnvResult(ProcedureType, tan));
-    env.emplace(Atom("real"), EnvResult(ProcedureType, real));
-    env.emplace(Atom("imag"), EnvResult(ProcedureType, imag));
-
-    env.emplace(Atom("list"), EnvResult(ProcedureType, list));
-    env.emplace(Atom("first"), EnvResult(ProcedureType, first));
-    env.emplace(Atom("rest"), EnvResult(ProcedureType, rest));
-    env.emplace(Atom("length"), EnvResult(ProcedureType, length));
-    env.emplace(Atom("append"), EnvResult(ProcedureType, append));
-    env.emplace(Atom("join"), EnvResult(ProcedureType, join));
-    env.emplace(Atom("range"), EnvResult(ProcedureType, range));
-    
-    env.emplace(Atom("apply"), EnvResult(ProcedureType, nop));
-    env.emplace(Atom("map"), EnvResult(ProcedureType, nop));
+std::shared_ptr<const Environment::Layer> Environment::builtins()
+{
+    static const std::shared_ptr<const Layer> layer = [] {
+        auto table = std::make_shared<Layer>();
+        auto& env = table->bindings;
+
+        env.emplace(Atom("pi"), EnvResult(Expression(std::atan2(0, -1))));
+        env.emplace(Atom("e"), EnvResult(Expression(std::exp(1))));
+        env.emplace(Atom("I"), EnvResult(Expression(std::complex<double>(0, 1))));
+        env.emplace(Atom("-I"), EnvResult(Expression(std::complex<double>(0, -1))));
+
+        return table;
+    }();
+
+    return layer;
+}
+
+namespace builtins {
 
-    env.emplace(Atom("set-property"), EnvResult(ProcedureType, set_prop));
-    env.emplace(Atom("get-property"), EnvResult(ProcedureType, get_prop));
-}
\ No newline at end of file
+namespace {
+
+    constexpr std::array<Kind, 3> kinds(Kind first, Kind rest) {
+        return { first, rest, rest };
+    }
+
+    constexpr std::array<Kind, 3> kinds(Kind all) {
+        return { all, all, all };
+    }
+
+    constexpr bool PURE = true;
+    constexpr bool IMPURE = false;
+
+    constexpr Builtin procedure(std::string_view name, Procedure proc, std::size_t min_args, std::size_t max_args,
+        std::array<Kind, 3> kinds, bool pure, BinaryProcedure binary = nullptr) {
+        return { name, proc, nullptr, binary, min_args, max_args, kinds, pure, false };
+    }
+
+    template <UnaryProcedure F>
+    constexpr Builtin unary(std::string_view name, Kind kind, bool pure) {
+        return { name, adapt_unary<F>, F, nullptr, 1, 1, kinds(kind), pure, false };
+    }
+
+    template <BinaryProcedure F>
+    constexpr Builtin binary(std::string_view name, std::array<Kind, 3> kinds, bool pure) {
+        return { name, adapt_binary<F>, nullptr, F, 2, 2, kinds, pure, false };
+    }
+
+    // map and friends call arbitrary procedures, so they are never pure
+    constexpr Builtin special_form(std::string_view name) {
+        return { name, nop, nullptr, nullptr, 0, VARIADIC, { Kind::Any, Kind::Any, Kind::Any }, false, true };
+    }
+
+    using enum Kind;
+
+    constexpr Builtin TABLE[] = {
+        procedure("+", add, 0, VARIADIC, kinds(Any), PURE, add),
+        procedure("-", sub_neg, 1, 2, kinds(Any), PURE, sub_neg),
+        procedure("*", mul, 0, VARIADIC, kinds(Any), PURE, mul),
+        procedure("/", div, 1, 2, kinds(Any), PURE, div),
+
+        unary<root>("sqrt", Number, PURE),
+        binary<pow>("^", kinds(Number), PURE),
+        binary<pow>("pow", kinds(Number), PURE),
+        unary<ln>("ln", Number, PURE),
+        procedure("log", log, 1, 2, kinds(Number), PURE),
+        unary<sin>("sin", Number, PURE),
+        unary<cos>("cos", Number, PURE),
+        unary<tan>("tan", Number, PURE),
+        unary<real>("real", Number, PURE),
+        unary<imag>("imag", Number, PURE),
+
+        procedure("list", list, 0, VARIADIC, kinds(Any), PURE),
+        unary<first>("first", List, PURE),
+        unary<rest>("rest", List, PURE),
+        unary<length>("length", List, PURE),
+        binary<append>("append", kinds(List, Any), PURE),
+        procedure("join", join, 1, VARIADIC, kinds(List), PURE),
+        procedure("range", range, 2, 3, kinds(Real), PURE),
+
+        special_form("apply"),
+        special_form("map"),
+        special_form("pmap"),
+        special_form("fold"),
+        special_form("reduce"),
+        special_form("continuous-plot"),
+
+        procedure("sum", sum, 1, 1, kinds(List), PURE),
+        procedure("product", product, 1, 1, kinds(List), PURE),
+        procedure("min", min, 1, 1, kinds(List), PURE),
+        procedure("max", max, 1, 1, kinds(List), PURE),
+        procedure("mean", mean, 1, 1, kinds(List), PURE),
+
+        procedure("set-property", set_prop, 3, 3, kinds(String, Any), PURE),
+        procedure("get-property", get_prop, 2, 2, kinds(String, Any), PURE),
+
+        procedure("make-point", point, 2, 2, kinds(Number), PURE),
+        procedure("make-line", line, 2, 2, kinds(Any), PURE),
+        procedure("make-text", text, 1, 1, kinds(Any), PURE),
+        procedure("write-svg", write_svg, 2, 2, kinds(String, Any), IMPURE),
+        procedure("spatial-index", spatial_index, 1, 1, kinds(List), PURE),
+        procedure("query-rect", query_rect, 5, 5, kinds(Native, Real), PURE),
+        procedure("nearest", nearest, 4, 4, kinds(Native, Real), PURE),
+        procedure("read-csv", read_csv, 1, 1, kinds(String), IMPURE),
+        procedure("read-csv-points", read_csv_points, 1, 1, kinds(String), IMPURE),
+        procedure("decimate-lttb", decimate_lttb, 2, 2, kinds(List, Real), PURE),
+        procedure("pdecimate-lttb", pdecimate_lttb, 2, 2, kinds(List, Real), PURE),
+        procedure("decimate-min-max", decimate_min_max, 2, 2, kinds(List, Real), PURE),
+        procedure("pdecimate-min-max", pdecimate_min_max, 2, 2, kinds(List, Real), PURE),
+
+        procedure("runtime-stats", runtime_stats, 0, 0, kinds(Any), IMPURE),
+        procedure("reset-runtime-stats", reset_runtime_stats, 0, 0, kinds(Any), IMPURE),
+    };
+
+    constexpr std::size_t COUNT = std::size(TABLE);
+    constexpr std::size_t SLOTS = 512;
+    constexpr std::uint8_t EMPTY = 0xff;
+    static_assert(COUNT < EMPTY, "slot indices are stored in a byte");
+
+    // FNV-1a with the seed folded into the offset basis
+    constexpr std::size_t slot(std::string_view name, std::uint64_t seed) {
+        std::uint64_t h = 14695981039346656037ull ^ (seed * 0x9e3779b97f4a7c15ull);
+        for (char c : name) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return static_cast<std::size_t>((h ^ (h >> 32)) % SLOTS);
+    }
+
+    // The first seed under which no two names share a slot.
+    constexpr std::uint64_t find_seed() {
+        for (std::uint64_t seed = 0;; seed++) {
+            std::array<bool, SLOTS> used{};
+            bool collision = false;
+            for (const auto& builtin : TABLE) {
+                std::size_t at = slot(builtin.name, seed);
+                collision = collision || used[at];
+                used[at] = true;
+            }
+            if (!collision)
+                return seed;
+        }
+    }
+
+    constexpr std::uint64_t SEED = find_seed();
+
+    constexpr std::array<std::uint8_t, SLOTS> INDEX = [] {
+        std::array<std::uint8_t, SLOTS> index{};
+        for (auto& i : index)
+            i = EMPTY;
+        for (std::size_t i = 0; i < COUNT; i++)
+            index[slot(TABLE[i].name, SEED)] = static_cast<std::uint8_t>(i);
+        return index;
+    }();
+
+    bool matches(Kind kind, const Expression& arg) {
+        // checked in this order so a packed list is never expanded
+        bool atom = !arg.packed() && !arg.native() && arg.tailConstBegin() == arg.tailConstEnd();
+        switch (kind) {
+            case Any: return true;
+            case Number: return atom && (arg.head().isNumber() || arg.head().isComplex());
+            case Real: return atom && arg.head().isNumber();
+            case String: return atom && arg.head().isString();
+            case List: return arg.head().isSymbol() && arg.head().asSymbol() == "list";
+            case Native: return arg.native() != nullptr;
+        }
+        return false;
+    }
+
+    std::string kind_name(Kind kind) {
+        switch (kind) {
+            case Number: return "a number";
+            case Real: return "a real number";
+            case String: return "a string";
+            case List: return "a list";
+            case Native: return "a native object";
+            default: return "a value";
+        }
+    }
+}
+
+const Builtin* find(std::string_view name) noexcept {
+    std::uint8_t i = INDEX[slot(name, SEED)];
+    return i != EMPTY && TABLE[i].name == name ? &TABLE[i] : nullptr;
+}
+
+std::span<const Builtin> all() noexcept {
+    return TABLE;
+}
+
+std::optional<Error> validate(const Builtin& builtin, Arguments args) {
+    std::string name(builtin.name);
+
+    if (args.size() < builtin.min_args || args.size() > builtin.max_args)
+        return Error("Error: in call to " + name + ": invalid number of arguments.");
+
+    for (std::size_t i = 0; i < args.size(); i++) {
+        if (!matches(builtin.kind(i), args[i]))
+            return Error("Error: in call to " + name + ": argument " + std::to_string(i + 1) + " was not " + kind_name(builtin.kind(i)) + ".");
+    }
+    return std::nullopt;
+}
+
+}
@@ -1,6 +1,174 @@
 #include "expression.h"
+#include "budget.h"
 #include "environment.h"
 #include "semantic_error.h"
+#include "thread_pool.h"
+#include "kernels.h"
+#include "packed.h"
+#include "profiler.h"
+#include "stats.h"
+#include "graphics.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+// Header of a tail's allocation; the items follow it in the same block.
+struct Expression::Tail::Block {
+	std::atomic<std::size_t> references;
+	std::size_t size;
+	std::size_t capacity;
+
+	Expression* items() noexcept {
+		return reinterpret_cast<Expression*>(this + 1);
+	}
+
+	static Block* allocate(std::size_t capacity) {
+		static_assert(sizeof(Block) % alignof(Expression) == 0);
+		void* memory = memory::allocate(sizeof(Block) + capacity * sizeof(Expression));
+		return new (memory) Block{ {1}, 0, capacity };
+	}
+};
+
+namespace {
+	// A first child usually has one sibling coming: (define x v), (+ a b).
+	constexpr std::size_t FIRST_CAPACITY = 2;
+}
+
+Expression::Tail::Tail(std::span<const Expression> items) {
+	if (items.empty())
+		return;
+	reserve(items.size());
+	for (const auto& item : items)
+		push_back(item);
+}
+
+Expression::Tail::Tail(std::vector<Expression>&& items) {
+	if (items.empty())
+		return;
+	reserve(items.size());
+	for (auto& item : items)
+		push_back(std::move(item));
+}
+
+Expression::Tail::Tail(const Tail& other) noexcept : block(other.block) {
+	// every copy of an Expression copies its tail
+	stats::add(stats::ExpressionCopies);
+	if (block != nullptr)
+		block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+Expression::Tail::Tail(Tail&& other) noexcept : block(std::exchange(other.block, nullptr)) {
+}
+
+Expression::Tail& Expression::Tail::operator=(const Tail& other) noexcept {
+	Tail copy(other);
+	std::swap(block, copy.block);
+	return *this;
+}
+
+Expression::Tail& Expression::Tail::operator=(Tail&& other) noexcept {
+	if (this != &other)
+		release(std::exchange(block, std::exchange(other.block, nullptr)));
+	return *this;
+}
+
+Expression::Tail::~Tail() {
+	release(block);
+}
+
+void Expression::Tail::release(Block* block) noexcept {
+	if (block == nullptr || block->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	Expression* items = block->items();
+	for (std::size_t i = 0; i < block->size; i++)
+		items[i].~Expression();
+	block->~Block();
+	memory::deallocate(block);
+}
+
+void Expression::Tail::reserve(std::size_t capacity) {
+	bool owned = block != nullptr && block->references.load(std::memory_order_acquire) == 1;
+	if (owned && block->capacity >= capacity)
+		return;
+
+	std::size_t size = this->size();
+	if (!owned && size != 0)
+		stats::add(stats::DeepCopies);
+	Block* fresh = Block::allocate(std::max(capacity, FIRST_CAPACITY));
+	Expression* items = fresh->items();
+	for (std::size_t i = 0; i < size; i++) {
+		// a shared block keeps its items for the other copies
+		if (owned)
+			new (items + i) Expression(std::move(block->items()[i]));
+		else
+			new (items + i) Expression(block->items()[i]);
+	}
+	fresh->size = size;
+
+	release(std::exchange(block, fresh));
+}
+
+std::size_t Expression::Tail::size() const noexcept {
+	return block == nullptr ? 0 : block->size;
+}
+
+bool Expression::Tail::empty() const noexcept {
+	return size() == 0;
+}
+
+const Expression* Expression::Tail::begin() const noexcept {
+	return block == nullptr ? nullptr : block->items();
+}
+
+const Expression* Expression::Tail::end() const noexcept {
+	return block == nullptr ? nullptr : block->items() + block->size;
+}
+
+const Expression& Expression::Tail::operator[](std::size_t i) const noexcept {
+	return block->items()[i];
+}
+
+const Expression& Expression::Tail::back() const noexcept {
+	return block->items()[block->size - 1];
+}
+
+// Shared by every empty call. It holds a reference to itself, so it is never
+// freed, and having no room, the first push_back moves to a block of its own.
+Expression::Tail::Block* Expression::Tail::empty_call_block() noexcept {
+	static Block block{ {1}, 0, 0 };
+	return &block;
+}
+
+void Expression::Tail::mark_empty_call() noexcept {
+	if (block != nullptr)
+		return;
+	block = empty_call_block();
+	block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Expression::Tail::empty_call() const noexcept {
+	return block == empty_call_block();
+}
+
+Expression& Expression::Tail::mutable_back() {
+	reserve(size());
+	return block->items()[block->size - 1];
+}
+
+void Expression::Tail::push_back(Expression item) {
+	std::size_t size = this->size();
+	std::size_t capacity = block == nullptr ? 0 : block->capacity;
+	reserve(size < capacity ? size + 1 : std::max(size * 2, size + 1));
+
+	new (block->items() + size) Expression(std::move(item));
+	block->size = size + 1;
+	stats::raise(stats::LongestTail, size + 1);
+}
 
 Expression::Expression(const Atom& a) {
 	m_head = a;
@@ -10,23 +178,20 @@ Expression::Expression() {
 	m_head = Atom();
 }
 
-Expression::Expression(const Atom& a, const std::vector<Expression>& items) {
+Expression::Expression(const Atom& a, const std::vector<Expression>& items) : m_tail(items) {
 	m_head = a;
-	m_tail = items;
 }
 
-Expression& Expression::operator=(const Expression& exp) {
-
-	if (this != &exp) {
-		m_head = exp.m_head;
-		m_tail.clear();
-		for (const auto& e : exp.m_tail)
-			m_tail.push_back(e);
+Expression::Expression(const Atom& a, std::vector<Expression>&& items) : m_tail(std::move(items)) {
+	m_head = a;
+}
 
-		m_properties = exp.m_properties;
-	}
+Expression::Expression(std::shared_ptr<const NumericVector> packed) : m_packed(std::move(packed)) {
+	m_head = Atom("list");
+}
 
-	return *this;
+Expression::Expression(std::shared_ptr<const NativeObject> native) : m_native(std::move(native)) {
+	m_head = Atom(m_native->name());
 }
 
 Atom Expression::head() const {
@@ -34,7 +199,7 @@ Atom Expression::head() const {
 }
 
 Expression* Expression::tail() {
-	return m_tail.empty() ? nullptr : &m_tail.back();
+	return m_tail.empty() ? nullptr : &m_tail.mutable_back();
 }
 
 void Expression::setHead(const Atom& a) {
@@ -42,38 +207,81 @@ void Expression::setHead(const Atom& a) {
 }
 
 void Expression::append(const Atom& a) {
-	m_tail.emplace_back(a);
+	m_tail.push_back(a);
+}
+
+void Expression::markEmptyCall() noexcept {
+	if (!m_packed)
+		m_tail.mark_empty_call();
+}
+
+bool Expression::isEmptyCall() const noexcept {
+	return m_tail.empty_call();
+}
+
+const Expression* Expression::tailConstBegin() const
+{
+	return items().data();
+}
+
+const Expression* Expression::tailConstEnd() const
+{
+	Arguments all = items();
+	return all.data() + all.size();
+}
+
+Arguments Expression::items() const
+{
+	if (m_packed)
+		return m_packed->expanded();
+	return { m_tail.begin(), m_tail.size() };
 }
 
-std::vector<Expression>::const_iterator Expression::tailConstBegin() const
+const NumericVector* Expression::packed() const noexcept
 {
-	return m_tail.cbegin();
+	return m_packed.get();
 }
 
-std::vector<Expression>::const_iterator Expression::tailConstEnd() const
+std::size_t Expression::itemCount() const noexcept
 {
-	return m_tail.cend();
+	return m_packed ? m_packed->size() : m_tail.size();
+}
+
+Expression Expression::item(std::size_t i) const
+{
+	return m_packed ? Expression(m_packed->at(i)) : m_tail[i];
+}
+
+const NativeObject* Expression::native() const noexcept
+{
+	return m_native.get();
 }
 
 void Expression::setProperty(const std::string& name, const Expression& value)
 {
-	if (m_properties.find(name) != m_properties.end()) {
-        auto data = m_properties.at(name);
-        m_properties.erase(name);
-    }
+	// copies made before this keep the properties they had
+	memory::Allocator<Properties> charged;
+	auto properties = m_properties ? std::allocate_shared<Properties>(charged, *m_properties)
+		: std::allocate_shared<Properties>(charged);
+	properties->insert_or_assign(name, value);
+	m_properties = std::move(properties);
+}
 
-	m_properties.emplace(name, new Expression(value));
+const Expression* Expression::findProperty(const std::string& name) const
+{
+	if (!m_properties)
+		return nullptr;
+	auto it = m_properties->find(name);
+	return it != m_properties->end() ? &it->second : nullptr;
 }
 
 Expression Expression::getProperty(const std::string& name)
 {
-	if (m_properties.find(name) != m_properties.end())
-		return *m_properties.at(name);
-	else
-		return {};
+	const Expression* value = findProperty(name);
+	return value != nullptr ? *value : Expression();
 }
 
-Expression Expression::handle_lookup(const Atom& a, const Environment& env)
+Result Expression::handle_lookup(const Atom& a, const Environment& env)
 {
 	if (env.is_exp(a)) {
 		return env.get_exp(a);
@@ -83,43 +291,42 @@ Expression Expression::handle_lookup(const Atom& a, const Environment& env)
 			return { a };
 	}
 
-	throw SemanticError("Unknown symbol: " + a.toString());
+	return Error("Unknown symbol: " + a.toString());
 	
 }
 
-Expression Expression::handle_begin(Environment& env)
+Result Expression::handle_begin(Environment& env) const
 {
-	Expression result;
+	Result result;
 	for (auto& it : m_tail) {
-		result = it.eval(env);
+		result = it.evaluate(env);
+		if (!result)
+			return result;
 	}
 	return result;
 }
 
-Expression Expression::handle_define(Environment& env) {
+Result Expression::handle_define(Environment& env) const {
 
 	if (m_tail.size() != 2) {
-		throw SemanticError("Error during handle define: Invalid number of arguments");
+		return Error("Error during handle define: Invalid number of arguments");
 	}
 	if (!m_tail[0].head().isSymbol()) {
-		throw SemanticError("Error during handle define: first argument to define not symbol");
+		return Error("Error during handle define: first argument to define not symbol");
 	}
 
 	Atom symbol = m_tail[0].head();
-	Expression value = m_tail[1].eval(env);
-	try {
-		env.add_exp(symbol, value);
-	}
-	catch (SemanticError& err) {
-		std::string msg("Error in handle_define: ");
-		msg += err.what();
-		throw SemanticError(msg);
-	}
+	Result value = m_tail[1].evaluate(env);
+	if (!value)
+		return value;
+
+	if (auto error = env.try_add_exp(symbol, *value))
+		return error->within("Error in handle_define: ");
 
 	return value;
 }
 
-Expression Expression::handle_lambda() {
+Result Expression::handle_lambda() const {
 
 	std::vector<Expression> lambda;
 
@@ -135,7 +342,7 @@ Expression Expression::handle_lambda() {
 	return { Atom("lambda"), lambda };
 }
 
-Expression evaluate_lambda(const Atom& op, const std::vector<Expression>& args, const Environment& env) {
+Result evaluate_lambda(const Atom& op, Arguments args, const Environment& env) {
 
 	Expression func = env.get_exp(op);
 	Expression arg_list = *func.tailConstBegin();
@@ -146,69 +353,269 @@ Expression evaluate_lambda(const Atom& op, const std::vector<Expression>& args,
 
 	for (auto param = arg_list.tailConstBegin(); param != arg_list.tailConstEnd(); param++) {
 		if (count == args.size())
-			throw SemanticError("Error: too few args given to anonymous function " + op.toString());
+			return Error("Error: too few args given to anonymous function " + op.toString());
 
-		scope.add_exp(param->head(), args[count++]);
+		if (auto error = scope.try_add_exp(param->head(), args[count++]))
+			return *error;
 	}
 
 	if (count != args.size())
-		throw SemanticError("Error: too many args given to anonymous function " + op.toString());
+		return Error("Error: too many args given to anonymous function " + op.toString());
+
+	const Expression& body = *(func.tailConstEnd() - 1);
+	return body.evaluate(scope);
+}
+
+Expected<Atom> Expression::handle_proc_arg(const Expression& arg, Environment& env, const std::string& cmd) {
+
+	Atom proc;
+	if (arg.m_tail.empty()) {
+		proc = arg.head();
+	}
+	else {
+		Result value = arg.evaluate(env);
+		if (!value)
+			return value.error();
+		proc = value->head();
+	}
+
+	if ((!env.is_proc(proc) && !env.is_lambda(proc)))
+		return Error("Error: first argument to " + cmd + " is not a procedure");
 
-	return func.tail()->eval(scope);
+	return proc;
 }
 
-Expression Expression::handle_proc_to_list(Environment& env) {
+Result Expression::handle_proc_to_list(Environment& env) const {
 
 	std::string cmd = m_head.toString();
+	profiler::Frame frame{ std::string_view(cmd) };
 
 	if (m_tail.size() != 2) {
-		throw SemanticError("Error: Not given 2 arguments to " + cmd);
+		return Error("Error: Not given 2 arguments to " + cmd);
 	}
 
-	Expression list = tail()->eval(env);
+	Result evaluated = m_tail.back().evaluate(env);
+	if (!evaluated)
+		return evaluated;
+	const Expression& list = *evaluated;
 
 	if (list.head().toString() != "list")
-		throw SemanticError("Error: second argument to " + cmd + " not a list");
+		return Error("Error: second argument to " + cmd + " not a list");
+
+	Expected<Atom> resolved = handle_proc_arg(m_tail[0], env, cmd);
+	if (!resolved)
+		return resolved.error();
+	const Atom& proc = *resolved;
+
+	Result result = Error("Unsupported operation");
+
+	if (cmd == "apply") {
+		if (list.packed()) {
+			std::vector<Expression> args;
+			args.reserve(list.itemCount());
+			for (std::size_t i = 0; i < list.itemCount(); i++)
+				args.push_back(list.item(i));
+			result = call(proc, args, env);
+		}
+		else {
+			result = call(proc, list.items(), env);
+		}
+	}
+	else if (cmd == "map") {
+		kernels::UnaryOp op;
+		std::vector<double> values;
+		if (env.is_proc(proc) && kernels::unary_op(proc.asSymbol(), op)
+			&& kernels::as_numbers(list, values) && kernels::in_domain(op, values)) {
+			for (std::size_t begin = 0; begin < values.size(); begin += Budget::BLOCK) {
+				std::size_t count = std::min(Budget::BLOCK, values.size() - begin);
+				if (auto stop = Budget::charge(count))
+					return stop->within("Error during map: ");
+				kernels::unary(op, values.data() + begin, values.data() + begin, count);
+			}
+			return kernels::to_list(std::move(values));
+		}
 
-	Atom proc;
-	if (m_tail[0].m_tail.empty())
-		proc = m_tail[0].head();
-	else
-		proc = m_tail[0].eval(env).head();
+		std::vector<Expression> items;
+		items.reserve(list.itemCount());
 
-	if ((!env.is_proc(proc) && !env.is_lambda(proc)))
-		throw SemanticError("Error: first argument to " + cmd + " is not a procedure");
+		result = Expression();
+		for (std::size_t i = 0; i < list.itemCount(); i++) {
+			Expression item = list.item(i);
+			Result mapped = call(proc, Arguments(&item, 1), env);
 
-	try {
-		if (cmd == "apply") {
-			return apply(m_head, list.m_tail, env);
-		}
-		else if (cmd == "map") {
-			std::vector<Expression> result;
-			std::vector<Expression> map_args;
-
-			for (auto& item : list.m_tail) {
-				map_args.push_back(item);
-				result.emplace_back(apply(proc, map_args, env));
-				map_args.clear();
+			if (!mapped) {
+				result = mapped;
+				break;
 			}
+			items.emplace_back(std::move(mapped).value());
+		}
 
-			return apply(Atom("list"), result, env);
+		if (result)
+			result = call(Atom("list"), items, env);
+	}
+	else if (cmd == "pmap") {
+		std::vector<Result> mapped(list.itemCount());
+
+		// workers only read env; evaluate_lambda gives each call its own scope
+		auto map_one = [&](std::size_t i) {
+			Expression item = list.item(i);
+			mapped[i] = call(proc, Arguments(&item, 1), env);
+		};
+
+		ThreadPool* pool = ThreadPool::current();
+		if (pool != nullptr) {
+			pool->parallel_for(mapped.size(), map_one);
 		}
 		else {
-			throw SemanticError("Unsupported operation");
+			for (std::size_t i = 0; i < mapped.size(); i++)
+				map_one(i);
 		}
+
+		// report the first failing item so errors do not depend on scheduling
+		std::vector<Expression> values;
+		values.reserve(mapped.size());
+		result = Expression();
+		for (auto& m : mapped) {
+			if (!m) {
+				result = m;
+				break;
+			}
+			values.emplace_back(std::move(m).value());
+		}
+
+		if (result)
+			result = call(Atom("list"), values, env);
+	}
+
+	if (!result)
+		return result.error().within("Error during apply: ");
+	return result;
+}
+
+Result Expression::handle_fold(Environment& env) const {
+
+	std::string cmd = m_head.toString();
+	profiler::Frame frame{ std::string_view(cmd) };
+	bool has_init = cmd == "fold";
+	std::size_t arity = has_init ? 3 : 2;
+
+	if (m_tail.size() != arity) {
+		return Error("Error: Not given " + std::to_string(arity) + " arguments to " + cmd);
+	}
+
+	Expected<Atom> resolved = handle_proc_arg(m_tail[0], env, cmd);
+	if (!resolved)
+		return resolved.error();
+	const Atom& proc = *resolved;
+
+	Result evaluated = m_tail.back().evaluate(env);
+	if (!evaluated)
+		return evaluated;
+	const Expression& list = *evaluated;
+
+	if (list.head().toString() != "list")
+		return Error("Error: last argument to " + cmd + " not a list");
+
+	std::size_t count = list.itemCount();
+	auto item = [&](std::size_t i) { return list.item(i); };
+
+	std::size_t next = 0;
+	Result result;
+	if (has_init) {
+		result = m_tail[1].evaluate(env);
+		if (!result)
+			return result;
 	}
-	catch (SemanticError& err) {
-		std::string msg("Error during apply: ");
-		msg += err.what();
-		throw SemanticError(msg);
+	else {
+		if (count == 0)
+			return Error("Error: reduce of empty list");
+		result = item(next++);
 	}
-	
+
+	// one pair of arguments is reused for every step
+	std::array<Expression, 2> step;
+	for (; next < count; next++) {
+		step[0] = std::move(result).value();
+		step[1] = item(next);
+		result = call(proc, step, env);
+		if (!result)
+			return result.error().within("Error during " + cmd + ": ");
+	}
+
+	return result;
+}
+
+Result Expression::handle_continuous_plot(Environment& env) const {
+
+	std::string cmd = m_head.toString();
+	profiler::Frame frame{ std::string_view(cmd) };
+
+	if (m_tail.size() < 2 || m_tail.size() > 4) {
+		return Error("Error: Not given 2 to 4 arguments to " + cmd);
+	}
+
+	Expected<Atom> resolved = handle_proc_arg(m_tail[0], env, cmd);
+	if (!resolved)
+		return resolved.error();
+	const Atom& proc = *resolved;
+
+	std::vector<Expression> args;
+	for (std::size_t i = 1; i < m_tail.size(); i++) {
+		Result arg = m_tail[i].evaluate(env);
+		if (!arg)
+			return arg;
+		args.push_back(std::move(arg).value());
+	}
+
+	const Expression& bounds = args[0];
+	auto lower = bounds.tailConstBegin();
+	if (bounds.head().toString() != "list" || bounds.tailConstEnd() - lower != 2
+		|| !lower->head().isNumber() || !(lower + 1)->head().isNumber())
+		return Error("Error: second argument to " + cmd + " is not a list of two numbers");
+	if (lower->head().asNumber() >= (lower + 1)->head().asNumber())
+		return Error("Error: second argument to " + cmd + " does not have its lower bound below its upper bound");
+
+	SampleOptions options;
+	if (args.size() > 1) {
+		if (!args[1].head().isNumber() || args[1].head().asNumber() <= 0)
+			return Error("Error: tolerance given to " + cmd + " is not a positive number");
+		options.tolerance = args[1].head().asNumber();
+	}
+	if (args.size() > 2) {
+		if (!args[2].head().isNumber() || args[2].head().asNumber() < 0)
+			return Error("Error: depth given to " + cmd + " is not a non-negative number");
+		options.max_depth = static_cast<int>(args[2].head().asNumber());
+	}
+
+	auto f = [&](double x) -> Expected<double> {
+		Expression point(Atom{ x });
+		Result y = call(proc, Arguments(&point, 1), env);
+		if (!y)
+			return y.error();
+		if (!y->head().isNumber())
+			return Error("Error: function given to " + cmd + " did not return a number");
+		return y->head().asNumber();
+	};
+
+	Result result = continuous_plot(f, lower->head().asNumber(), (lower + 1)->head().asNumber(), options);
+	if (!result)
+		return result.error().within("Error during " + cmd + ": ");
+	return result;
 }
 
-Expression Expression::eval(Environment& env)
+Expression Expression::eval(Environment& env) const
 {
+	return evaluate(env).value_or_throw();
+}
+
+Result Expression::evaluate(Environment& env) const
+{
+	if (m_packed || m_native)
+		return *this;
+
+	if (auto stop = Budget::charge())
+		return *stop;
+
 	std::string cmd(m_head.toString());
 
 	if (cmd == "begin") {
@@ -221,31 +628,82 @@ Expression Expression::eval(Environment& env)
 		return handle_lambda();
 	}
 	else if (m_tail.empty()) {
+		if (m_tail.empty_call()) {
+			if (const builtins::Builtin* builtin = env.builtin(m_head); builtin != nullptr && builtin->max_args == 0)
+				return call(m_head, {}, env);
+		}
 		return handle_lookup(m_head, env);
 	}
-	if (cmd == "apply" || cmd == "map") {
+	if (cmd == "apply" || cmd == "map" || cmd == "pmap") {
 		return handle_proc_to_list(env);
 	}
+	if (cmd == "fold" || cmd == "reduce") {
+		return handle_fold(env);
+	}
+	if (cmd == "continuous-plot") {
+		return handle_continuous_plot(env);
+	}
 	else {
-		std::vector<Expression> args;
-		for (auto & it : m_tail){
-			args.push_back(it.eval(env));
+		return handle_call(env);
+	}
+}
+
+Result Expression::handle_call(Environment& env) const {
+
+	// short calls keep their arguments on the stack
+	constexpr std::size_t STACK_ARGS = 4;
+	std::size_t count = m_tail.size();
+
+	if (count <= STACK_ARGS) {
+		std::array<Expression, STACK_ARGS> args;
+		for (std::size_t i = 0; i < count; i++) {
+			Result arg = m_tail[i].evaluate(env);
+			if (!arg)
+				return arg;
+			args[i] = std::move(arg).value();
 		}
-		return apply(m_head, args, env);
+		return call(m_head, Arguments(args.data(), count), env);
+	}
+
+	std::vector<Expression> args;
+	args.reserve(count);
+	for (auto & it : m_tail){
+		Result arg = it.evaluate(env);
+		if (!arg)
+			return arg;
+		args.push_back(std::move(arg).value());
 	}
+	return call(m_head, args, env);
 }
 
 Expression Expression::apply(const Atom& op, const std::vector<Expression>& args, const Environment& env) {
+	return call(op, args, env).value_or_throw();
+}
 
-	if (env.is_proc(op)) {
-		return env.get_proc(op)(args);
+Result Expression::call(const Atom& op, Arguments args, const Environment& env) {
+
+	if (auto stop = Budget::charge())
+		return *stop;
+
+	if (const builtins::Builtin* builtin = env.builtin(op)) {
+		profiler::Frame frame(builtin->name);
+		stats::add(stats::BuiltinCalls);
+		if (auto error = builtins::validate(*builtin, args))
+			return *error;
+		if (args.size() == 1 && builtin->unary != nullptr)
+			return builtin->unary(args[0]);
+		if (args.size() == 2 && builtin->binary != nullptr)
+			return builtin->binary(args[0], args[1]);
+		return builtin->proc(args);
 	}
 
 	if (env.is_lambda(op)) {
+		profiler::Frame frame(op);
+		stats::add(stats::LambdaCalls);
 		return evaluate_lambda(op, args, env);
 	}
 
-	throw SemanticError(op.toString() + " is not a procedure.");
+	return Error(op.toString() + " is not a procedure.");
 }
 
 std::string Expression::toString() const {
@@ -279,6 +737,16 @@ std::string Expression::toString() const {
                 out << ")";
         }
     }
+    else if (m_native) {
+        out << m_native->describe();
+    }
+    else if (m_packed) {
+        for (std::size_t i = 0; i < m_packed->size(); i++) {
+            if (i != 0)
+                out << " ";
+            out << "(" << m_packed->at(i) << ")";
+        }
+    }
     else {
         if (head != "list" )
             out << m_head;
@@ -301,23 +769,86 @@ std::ostream& operator<<(std::ostream& out, const Expression& exp) {
 
 bool Expression::operator==(const Expression& exp) const noexcept {
 
+	if (m_native || exp.m_native)
+		return m_native == exp.m_native;
+
 	bool result = m_head == exp.m_head;
 
-	result = result && (m_tail.size() == exp.m_tail.size());
+	// copies share their children, which are never changed while shared
+	if (m_packed != nullptr && m_packed == exp.m_packed)
+		return result;
+	if (!m_tail.empty() && m_tail.begin() == exp.m_tail.begin())
+		return result;
+
+	if (result && m_packed && exp.m_packed) {
+		result = m_packed->size() == exp.m_packed->size();
+		for (std::size_t i = 0; result && i < m_packed->size(); i++)
+			result = m_packed->at(i) == exp.m_packed->at(i);
+		return result;
+	}
+
+	Arguments left = items();
+	Arguments right = exp.items();
+
+	result = result && (left.size() == right.size());
 
 	if (result) {
-		for (int i = 0 ; i < m_tail.size(); i++) {
-			result &= (m_tail[i] == exp.m_tail[i]);
+		for (std::size_t i = 0 ; i < left.size(); i++) {
+			result &= (left[i] == right[i]);
 		}
 	}
 
 	return result;
 }
 
+bool Expression::identical(const Expression& exp) const noexcept {
+	if (m_native != exp.m_native)
+		return false;
+	if (!m_head.identical(exp.m_head) || isEmptyCall() != exp.isEmptyCall())
+		return false;
+
+	if (m_properties != exp.m_properties) {
+		static const Properties none;
+		const Properties& left = m_properties ? *m_properties : none;
+		const Properties& right = exp.m_properties ? *exp.m_properties : none;
+		if (!std::equal(left.begin(), left.end(), right.begin(), right.end(), [](const auto& x, const auto& y) {
+				return x.first == y.first && x.second.identical(y.second);
+			}))
+			return false;
+	}
+
+	// copies share their children, which are never changed while shared
+	if (m_packed != nullptr && m_packed == exp.m_packed)
+		return true;
+	if (!m_tail.empty() && m_tail.begin() == exp.m_tail.begin())
+		return true;
+
+	if (m_packed && exp.m_packed) {
+		auto same_bits = [](const std::vector<double>& x, const std::vector<double>& y) {
+			return std::equal(x.begin(), x.end(), y.begin(), y.end(), [](double l, double r) {
+				return std::bit_cast<std::uint64_t>(l) == std::bit_cast<std::uint64_t>(r);
+			});
+		};
+		return m_packed->isComplex() == exp.m_packed->isComplex()
+			&& same_bits(m_packed->reals(), exp.m_packed->reals())
+			&& same_bits(m_packed->imags(), exp.m_packed->imags());
+	}
+
+	Arguments left = items();
+	Arguments right = exp.items();
+	return std::equal(left.begin(), left.end(), right.begin(), right.end(), [](const Expression& x, const Expression& y) {
+		return x.identical(y);
+	});
+}
+
 bool Expression::isEmpty() const noexcept {
     return m_head.isNone() && m_tail.empty();
 }
 
+bool Expression::isPlainNumber() const noexcept {
+    return (m_head.isNumber() || m_head.isComplex()) && m_tail.empty() && !m_packed && !m_properties;
+}
+
 bool operator!=(const Expression& left, const Expression& right) noexcept {
 	return !(left == right);
 }
\ No newline at end of file
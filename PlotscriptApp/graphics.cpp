@@ -0,0 +1,170 @@
+#include "graphics.h"
+#include "packed.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <optional>
+
+Expression make_point(const Atom& x, const Atom& y) {
+	// packed, like the (list x y) a script would evaluate
+	const Expression coordinates[] = { Expression(x), Expression(y) };
+	Expression point(NumericVector::pack(coordinates));
+	point.setProperty("\"object-name\"", Expression(Atom("\"point\"")));
+	point.setProperty("\"size\"", Expression(Atom(1.0)));
+	return point;
+}
+
+Expression make_line(const Expression& start, const Expression& end) {
+	Expression line(Atom("list"), { start, end });
+	line.setProperty("\"object-name\"", Expression(Atom("\"line\"")));
+	line.setProperty("\"thickness\"", Expression(Atom(1.0)));
+	return line;
+}
+
+Expression make_text(const Expression& text) {
+	Expression result(Atom("list"), { text });
+	result.setProperty("\"object-name\"", Expression(Atom("\"text\"")));
+	result.setProperty("\"position\"", make_point(0.0, 0.0));
+	result.setProperty("\"text-scale\"", Expression(Atom(1.0)));
+	result.setProperty("\"text-rotation\"", Expression(Atom(0.0)));
+	return result;
+}
+
+std::string object_name(const Expression& obj) {
+	const Expression* name = obj.findProperty("\"object-name\"");
+	if (name == nullptr || !name->head().isString())
+		return {};
+
+	std::string text = name->head().asSymbol();
+	return text.substr(1, text.size() - 2);
+}
+
+bool point_coordinates(const Expression& obj, double& x, double& y) {
+	// read packed points in place; expanding them would cache an item vector per point
+	if (const NumericVector* packed = obj.packed()) {
+		if (packed->size() != 2 || packed->isComplex())
+			return false;
+		x = packed->reals()[0];
+		y = packed->reals()[1];
+		return true;
+	}
+
+	auto it = obj.tailConstBegin();
+	if (obj.tailConstEnd() - it != 2 || !it->head().isNumber() || !(it + 1)->head().isNumber())
+		return false;
+	x = it->head().asNumber();
+	y = (it + 1)->head().asNumber();
+	return true;
+}
+
+namespace {
+
+	// Evaluates f at every x, in parallel when a pool is bound to this thread.
+	// The first error in input order is returned.
+	std::optional<Error> sample(const std::function<Expected<double>(double)>& f,
+		const std::vector<double>& xs, std::vector<double>& ys) {
+
+		std::vector<Expected<double>> results(xs.size());
+		auto sample_one = [&](std::size_t i) { results[i] = f(xs[i]); };
+
+		ThreadPool* pool = ThreadPool::current();
+		if (pool != nullptr) {
+			pool->parallel_for(xs.size(), sample_one);
+		}
+		else {
+			for (std::size_t i = 0; i < xs.size(); i++)
+				sample_one(i);
+		}
+
+		ys.clear();
+		for (auto& r : results) {
+			if (!r)
+				return r.error();
+			ys.push_back(*r);
+		}
+		return std::nullopt;
+	}
+
+	// How far the curve turns at p1, in degrees, measured in coordinates scaled
+	// to the plot box so the tolerance does not depend on the units of x and y.
+	double bend(double x0, double y0, double x1, double y1, double x2, double y2, double sx, double sy) {
+		double ux = (x0 - x1) * sx, uy = (y0 - y1) * sy;
+		double vx = (x2 - x1) * sx, vy = (y2 - y1) * sy;
+
+		double norms = std::hypot(ux, uy) * std::hypot(vx, vy);
+		if (norms == 0 || !std::isfinite(norms))
+			return 0;
+
+		double cosine = std::clamp((ux * vx + uy * vy) / norms, -1.0, 1.0);
+		return 180 - std::acos(cosine) * 180 / std::numbers::pi;
+	}
+}
+
+Result continuous_plot(const std::function<Expected<double>(double)>& f,
+	double lower, double upper, const SampleOptions& options) {
+
+	std::size_t segments = std::max<std::size_t>(1, options.initial_segments);
+	std::vector<double> xs, ys;
+	for (std::size_t i = 0; i <= segments; i++)
+		xs.push_back(lower + (upper - lower) * static_cast<double>(i) / static_cast<double>(segments));
+
+	if (auto error = sample(f, xs, ys))
+		return *error;
+
+	for (int depth = 0; depth < options.max_depth; depth++) {
+
+		double low = INFINITY, high = -INFINITY;
+		for (double y : ys) {
+			if (std::isfinite(y)) {
+				low = std::min(low, y);
+				high = std::max(high, y);
+			}
+		}
+		double sx = upper > lower ? 1 / (upper - lower) : 1;
+		double sy = high > low ? 1 / (high - low) : 1;
+
+		std::vector<bool> split(xs.size() - 1, false);
+		bool any = false;
+		for (std::size_t i = 1; i + 1 < xs.size(); i++) {
+			if (bend(xs[i - 1], ys[i - 1], xs[i], ys[i], xs[i + 1], ys[i + 1], sx, sy) > options.tolerance) {
+				split[i - 1] = split[i] = true;
+				any = true;
+			}
+		}
+		if (!any)
+			break;
+
+		std::vector<double> mid_xs, mid_ys;
+		for (std::size_t i = 0; i < split.size(); i++) {
+			if (split[i])
+				mid_xs.push_back((xs[i] + xs[i + 1]) / 2);
+		}
+		if (auto error = sample(f, mid_xs, mid_ys))
+			return *error;
+
+		std::vector<double> next_xs, next_ys;
+		std::size_t m = 0;
+		for (std::size_t i = 0; i < xs.size(); i++) {
+			next_xs.push_back(xs[i]);
+			next_ys.push_back(ys[i]);
+			if (i < split.size() && split[i]) {
+				next_xs.push_back(mid_xs[m]);
+				next_ys.push_back(mid_ys[m++]);
+			}
+		}
+		xs.swap(next_xs);
+		ys.swap(next_ys);
+	}
+
+	std::vector<Expression> lines;
+	lines.reserve(xs.size() - 1);
+	for (std::size_t i = 0; i + 1 < xs.size(); i++) {
+		// leave a gap where the function is undefined
+		if (std::isfinite(ys[i]) && std::isfinite(ys[i + 1]))
+			lines.push_back(make_line(make_point(xs[i], ys[i]), make_point(xs[i + 1], ys[i + 1])));
+	}
+
+	return { Atom("list"), lines };
+}
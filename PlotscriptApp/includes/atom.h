@@ -29,6 +29,9 @@ public:
 	bool operator==(const Atom&) const noexcept;
 	bool operator!=(const Atom&) const noexcept;
 	bool operator<(const Atom&) const noexcept;
+	// Same type and value, numbers compared bit for bit rather than within
+	// the tolerance operator== allows.
+	[[nodiscard]] bool identical(const Atom&) const noexcept;
 
 private:
     enum class Type {None, Number, Symbol, Complex};
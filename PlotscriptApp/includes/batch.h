@@ -0,0 +1,36 @@
+#pragma once
+
+#include "interpreter.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// plotscript --batch: evaluates the top-level forms of a file as independent
+// jobs spread over worker threads. Each worker forks its own interpreter from
+// a warm one and runs every job in a fresh fork of that, so a job can neither
+// see another's definitions nor stop the batch by failing.
+namespace batch {
+
+	struct Job {
+		std::string program;
+		// line of the file the form starts on, from 1
+		std::size_t line;
+	};
+
+	// Splits text into its top-level forms. Text between forms that is not a
+	// form, such as a bare symbol or a stray ')', becomes a job of its own and
+	// fails to parse.
+	std::vector<Job> split(const std::string& text);
+
+	struct Outcome {
+		bool ok;
+		std::string text;
+	};
+
+	// Runs jobs on workers threads. emit is called on the calling thread, once
+	// for every job and in input order, as soon as the jobs before it are done.
+	void run(const std::vector<Job>& jobs, Interpreter& interp, std::size_t workers,
+		const std::function<void(std::size_t, const Outcome&)>& emit);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "memory.h"
+#include "result.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Limits on a single evaluation; zero leaves a limit off.
+struct Limits {
+	// evaluation steps: every evaluated expression and procedure call, and
+	// every item handled by a native loop such as range, map or join
+	std::uint64_t fuel = 0;
+	// wall-clock time from the start of the evaluation
+	std::chrono::milliseconds deadline{0};
+	// largest single allocation, in bytes, that a builtin may make for a list
+	std::size_t max_alloc = 0;
+	// bytes the interpreter may hold, its definitions included
+	std::size_t max_memory = 0;
+};
+
+// Lets another thread or a signal handler stop an evaluation in progress.
+class Cancellation {
+public:
+	// Requests a stop; false when nothing is being evaluated or a stop is
+	// already pending.
+	bool cancel() noexcept;
+
+	[[nodiscard]] bool requested() const noexcept;
+
+private:
+	friend class Budget;
+	std::atomic<bool> stop{false};
+	std::atomic<bool> running{false};
+};
+
+// What one evaluation may still spend. The budget in use is bound to the
+// evaluating thread, like ThreadPool::current(), and is carried over to the
+// pool's workers by parallel_for. The evaluator charges it at every eval and
+// apply; long native loops charge it per block of items.
+class Budget {
+public:
+	// memory, when given, is the account whose limit the evaluation answers to
+	Budget(const Limits& limits, Cancellation* cancellation, const MemoryAccount* memory = nullptr);
+	~Budget();
+
+	Budget(const Budget&) = delete;
+	Budget& operator=(const Budget&) = delete;
+
+	// Items a native loop handles between charges.
+	static constexpr std::size_t BLOCK = 4096;
+
+	// Spends steps of fuel; an Error with its Stop once the evaluation has to
+	// stop.
+	std::optional<Error> step(std::uint64_t steps = 1);
+
+	// An Error, with Stop::Allocation or Stop::Memory, when bytes is more than
+	// a single allocation may take or more than the memory account has left.
+	[[nodiscard]] std::optional<Error> allocate(std::size_t bytes) const;
+
+	// Budget bound to the calling thread, or nullptr when evaluation is unlimited.
+	static Budget* current() noexcept;
+
+	// step() and allocate() on the current budget, if there is one.
+	static std::optional<Error> charge(std::uint64_t steps = 1);
+	static std::optional<Error> reserve(std::size_t bytes);
+
+	class Scope {
+	public:
+		explicit Scope(Budget* budget) noexcept;
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		Budget* previous;
+	};
+
+private:
+	std::optional<Error> stopped(Stop why);
+
+	Limits limits;
+	std::chrono::steady_clock::time_point deadline;
+	Cancellation* cancellation;
+	const MemoryAccount* memory;
+	std::atomic<std::uint64_t> used{0};
+	std::atomic<Stop> reason{Stop::None};
+};
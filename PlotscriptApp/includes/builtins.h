@@ -0,0 +1,85 @@
+#pragma once
+
+#include "expression.h"
+#include "result.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+typedef Result (*Procedure)(Arguments args);
+
+// Entry points for the common one- and two-argument calls, used instead of
+// proc when the arity matches.
+typedef Result (*UnaryProcedure)(const Expression& arg);
+typedef Result (*BinaryProcedure)(const Expression& left, const Expression& right);
+
+// The former calling convention, for procedures that still want a vector.
+typedef Result (*VectorProcedure)(const std::vector<Expression>& args);
+
+// The builtin procedures, described by one constexpr table. Arity and argument
+// kinds are checked by validate() before any builtin runs, so the procedures
+// themselves only check what the table cannot express.
+namespace builtins {
+
+	enum class Kind : std::uint8_t {
+		Any,
+		Number,		// a real or complex number
+		Real,		// a real number
+		String,
+		List,
+		Native		// a native object such as a spatial index
+	};
+
+	constexpr std::size_t VARIADIC = static_cast<std::size_t>(-1);
+
+	// Wrap the other conventions as a Procedure; adapt_vector copies the
+	// arguments into a vector.
+	template <VectorProcedure F>
+	Result adapt_vector(Arguments args) {
+		return F(std::vector<Expression>(args.begin(), args.end()));
+	}
+
+	template <UnaryProcedure F>
+	Result adapt_unary(Arguments args) {
+		return F(args[0]);
+	}
+
+	template <BinaryProcedure F>
+	Result adapt_binary(Arguments args) {
+		return F(args[0], args[1]);
+	}
+
+	struct Builtin {
+		std::string_view name;
+		Procedure proc;
+		UnaryProcedure unary;
+		BinaryProcedure binary;
+		std::size_t min_args;
+		std::size_t max_args;
+		// kinds[i] is the kind of argument i; the last entry covers the rest
+		std::array<Kind, 3> kinds;
+		// same arguments, same result, and no effect outside the interpreter
+		bool pure;
+		// evaluated by Expression::evaluate itself; proc is a placeholder
+		bool special;
+
+		[[nodiscard]] constexpr Kind kind(std::size_t i) const noexcept {
+			return kinds[std::min(i, kinds.size() - 1)];
+		}
+	};
+
+	// Perfect-hash lookup of a builtin by name, nullptr if there is none.
+	const Builtin* find(std::string_view name) noexcept;
+
+	// Every builtin, in declaration order.
+	std::span<const Builtin> all() noexcept;
+
+	// Checks args against the builtin's arity and argument kinds.
+	std::optional<Error> validate(const Builtin& builtin, Arguments args);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "result.h"
+
+#include <string>
+#include <vector>
+
+// Numeric CSV/TSV loading for read-csv. The file is memory mapped, cut into
+// line-aligned chunks and the chunks are parsed with std::from_chars on the
+// current pool; no tokens or intermediate strings are created.
+namespace csv {
+
+	using Columns = std::vector<std::vector<double>>;
+
+	// Fields are split on tabs when the first line has one, otherwise on commas.
+	// A first line that does not parse as numbers is taken as a header and
+	// skipped. Blank lines are ignored; every other line must have the same
+	// number of numeric fields.
+	Expected<Columns> read(const std::string& path);
+}
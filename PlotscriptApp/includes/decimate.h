@@ -0,0 +1,32 @@
+#pragma once
+
+#include "expression.h"
+#include "result.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Level-of-detail reduction of point series for plots with far more points
+// than pixels. Each reducer returns the indices of the points to keep, in
+// order, so callers can hand back the original objects with their properties.
+namespace decimate {
+
+	struct Series {
+		std::vector<double> x;
+		std::vector<double> y;
+	};
+
+	// Reads a list of make-point objects or (x y) pairs, on the current pool when
+	// parallel is set.
+	std::optional<Error> read(const Expression& list, Series& series, bool parallel);
+
+	// Largest-Triangle-Three-Buckets. The parallel version runs fixed blocks of
+	// buckets independently; the first bucket of each block is anchored on the
+	// centroid of the bucket before it rather than on the point chosen there.
+	std::vector<std::size_t> lttb(const Series& series, std::size_t target, bool parallel);
+
+	// Splits the series into target / 2 buckets and keeps the lowest and the
+	// highest point of each. Serial and parallel results are identical.
+	std::vector<std::size_t> min_max(const Series& series, std::size_t target, bool parallel);
+}
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "builtins.h"
 #include "expression.h"
+#include "result.h"
 #include <map>
 #include <cmath>
-
-typedef Expression (*Procedure)(const std::vector<Expression>& args);
+#include <memory>
+#include <optional>
 
 class Environment {
 public:
@@ -16,23 +18,44 @@ public:
     [[nodiscard]] bool is_lambda(const Atom& sym) const;
 
 	[[nodiscard]] Procedure get_proc(const Atom& sym) const;
+	// The table entry for a builtin procedure, nullptr for anything else.
+	[[nodiscard]] const builtins::Builtin* builtin(const Atom& sym) const;
 	[[nodiscard]] Expression get_exp(const Atom& sym) const;
 
 	void add_exp(const Atom& sym, const Expression& value);
+	[[nodiscard]] std::optional<Error> try_add_exp(const Atom& sym, const Expression& value);
 	void reset();
 
-private:
-	enum EnvType {ExpressionType, ProcedureType};
+	// Freezes the definitions made so far into a layer shared with the returned
+	// environment. Either side's later definitions stay its own. Layers are
+	// merged as they stack up, so lookups stay O(log n) deep however often an
+	// environment is forked, at an amortized O(log n) copies per definition.
+	Environment fork();
 
+private:
 	struct EnvResult {
-		EnvType type;
 		Expression exp;
-		Procedure proc = nullptr;
 
-		EnvResult(EnvType t, const Expression& e) : type(t), exp(e) {};
-		EnvResult(EnvType t, Procedure p) : type(t), proc(p) {};
+		explicit EnvResult(const Expression& e) : exp(e) {};
 	};
 
-	std::map<Atom, EnvResult> env;
+	// Immutable bindings shared between environments. The builtin constants are
+	// one process-wide layer; fork() stacks the forked definitions on top of it.
+	// Builtin procedures are not bound here but looked up in builtins::find.
+	// charged to the interpreter that made the definitions
+	using Bindings = std::map<Atom, EnvResult, std::less<Atom>,
+		memory::Allocator<std::pair<const Atom, EnvResult>>>;
+
+	struct Layer {
+		Bindings bindings;
+		std::shared_ptr<const Layer> parent;
+	};
+
+	static std::shared_ptr<const Layer> builtins();
+	[[nodiscard]] const EnvResult* find(const Atom& sym) const;
+
+	// this environment's own definitions, looked up before the shared layers
+	Bindings env;
+	std::shared_ptr<const Layer> shared;
 };
 
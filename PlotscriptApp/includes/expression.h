@@ -1,50 +1,161 @@
 #pragma once
 
 #include "atom.h"
+#include "memory.h"
+#include "result.h"
 #include <utility>
 #include <iostream>
 #include <vector>
 #include <map>
+#include <memory>
+#include <span>
+#include <string>
 
 class Environment;
+class NumericVector;
+class Expression;
+
+// A value implemented in C++ rather than as a list, such as a spatial index.
+// Native objects are immutable and shared by every copy of the expression
+// holding them.
+class NativeObject {
+public:
+	virtual ~NativeObject() = default;
+
+	// Symbol used as the head of the expression holding the object.
+	[[nodiscard]] virtual std::string name() const = 0;
+	// Printed form, without the enclosing parentheses.
+	[[nodiscard]] virtual std::string describe() const = 0;
+};
+
+// Evaluation result: the value, or the error that stopped evaluation.
+using Result = Expected<Expression>;
+
+// Evaluated arguments of a call, as a span over storage owned by the caller,
+// usually the evaluator's stack, so that a call allocates nothing.
+using Arguments = std::span<const Expression>;
 
 class Expression {
 public:
 	Expression();
 	/* Implicit */ Expression(const Atom&); //NOLINT
 	Expression(const Atom&, const std::vector<Expression>& items);
-
-	Expression& operator=(const Expression& e);
+	Expression(const Atom&, std::vector<Expression>&& items);
+	explicit Expression(std::shared_ptr<const NumericVector> packed);
+	explicit Expression(std::shared_ptr<const NativeObject> native);
 
 	[[nodiscard]] Atom head() const;
+	// Last child, or nullptr; copies sharing the children are detached first.
 	Expression* tail();
 
     void setHead(const Atom &a);
     void append(const Atom &a);
 
-    [[nodiscard]] std::vector<Expression>::const_iterator tailConstBegin() const;
-    [[nodiscard]] std::vector<Expression>::const_iterator tailConstEnd() const;
+	// (f) parses to the same tree as a bare f. The parser marks the
+	// parenthesized form, and evaluating it calls f when f is a builtin that
+	// takes no arguments; either form looks anything else up. Marking an
+	// expression that has children does nothing.
+	void markEmptyCall() noexcept;
+	[[nodiscard]] bool isEmptyCall() const noexcept;
+
+    [[nodiscard]] const Expression* tailConstBegin() const;
+    [[nodiscard]] const Expression* tailConstEnd() const;
 
-	Expression eval(Environment& env);
+	// Throwing wrappers: errors surface as SemanticError.
+	Expression eval(Environment& env) const;
 	static Expression apply(const Atom& op, const std::vector<Expression>& args, const Environment& env);
 
+	// Non-throwing evaluation used internally and by the builtins.
+	Result evaluate(Environment& env) const;
+	static Result call(const Atom& op, Arguments args, const Environment& env);
+
 	bool operator==(const Expression& exp) const noexcept;
+	// Stricter than operator==: numbers must match bit for bit, and the
+	// properties, the empty-call mark and native objects must match too.
+	[[nodiscard]] bool identical(const Expression& exp) const noexcept;
 	[[nodiscard]] std::string toString() const;
 	void setProperty(const std::string&, const Expression&);
 	Expression getProperty(const std::string&);
+	[[nodiscard]] const Expression* findProperty(const std::string&) const;
 
     [[nodiscard]] bool isEmpty() const noexcept;
+    [[nodiscard]] bool isPlainNumber() const noexcept;
+
+    // Non-null when this is a list of numbers held in packed form.
+    [[nodiscard]] const NumericVector* packed() const noexcept;
+
+    // The number of children, and child i by value. A packed list is read in
+    // place, where tailConstBegin() would expand every item.
+    [[nodiscard]] std::size_t itemCount() const noexcept;
+    [[nodiscard]] Expression item(std::size_t i) const;
+
+    // Non-null when this expression holds a native object.
+    [[nodiscard]] const NativeObject* native() const noexcept;
 
 private:
+	// The children, in one block that starts with room for two and doubles,
+	// shared between copies until one of them changes. A node is one pointer
+	// wide however many children it has, and copying a tree, as a lookup or a
+	// lambda call does, allocates nothing.
+	class Tail {
+	public:
+		Tail() noexcept = default;
+		explicit Tail(std::span<const Expression> items);
+		explicit Tail(std::vector<Expression>&& items);
+		Tail(const Tail&) noexcept;
+		Tail(Tail&&) noexcept;
+		Tail& operator=(const Tail&) noexcept;
+		Tail& operator=(Tail&&) noexcept;
+		~Tail();
+
+		[[nodiscard]] std::size_t size() const noexcept;
+		[[nodiscard]] bool empty() const noexcept;
+		[[nodiscard]] const Expression* begin() const noexcept;
+		[[nodiscard]] const Expression* end() const noexcept;
+		const Expression& operator[](std::size_t i) const noexcept;
+		[[nodiscard]] const Expression& back() const noexcept;
+
+		// An empty tail that stands for a call with no arguments.
+		void mark_empty_call() noexcept;
+		[[nodiscard]] bool empty_call() const noexcept;
+
+		// Last child, after detaching from any other copy.
+		Expression& mutable_back();
+		void push_back(Expression item);
+
+	private:
+		struct Block;
+
+		static Block* empty_call_block() noexcept;
+
+		// Leaves this the only owner of a block with room for capacity items.
+		void reserve(std::size_t capacity);
+		static void release(Block* block) noexcept;
+
+		Block* block = nullptr;
+	};
+
+	// set rarely, mostly on graphics objects, so absent until the first one
+	using Properties = std::map<std::string, Expression, std::less<std::string>,
+		memory::Allocator<std::pair<const std::string, Expression>>>;
+
 	Atom m_head;
-	std::vector<Expression> m_tail;
-	std::map<std::string, Expression*> m_properties;
-
-	static Expression handle_lookup(const Atom&, const Environment&);
-	Expression handle_begin(Environment&);
-	Expression handle_define(Environment&);
-	Expression handle_lambda();
-	Expression handle_proc_to_list(Environment&);
+	Tail m_tail;
+	std::shared_ptr<const Properties> m_properties;
+	std::shared_ptr<const NumericVector> m_packed;
+	std::shared_ptr<const NativeObject> m_native;
+
+	[[nodiscard]] Arguments items() const;
+
+	static Result handle_lookup(const Atom&, const Environment&);
+	Result handle_begin(Environment&) const;
+	Result handle_define(Environment&) const;
+	Result handle_lambda() const;
+	Result handle_proc_to_list(Environment&) const;
+	Result handle_fold(Environment&) const;
+	Result handle_continuous_plot(Environment&) const;
+	Result handle_call(Environment&) const;
+	static Expected<Atom> handle_proc_arg(const Expression&, Environment&, const std::string&);
 };
 
 std::ostream& operator<<(std::ostream&, const Expression&);
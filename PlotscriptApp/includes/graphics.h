@@ -0,0 +1,32 @@
+#pragma once
+
+#include "expression.h"
+#include "result.h"
+
+#include <functional>
+#include <string>
+
+// The graphics object constructors behind make-point, make-line and make-text.
+// Each builds its property-tagged list in place rather than copying it through
+// a chain of set-property calls.
+Expression make_point(const Atom& x, const Atom& y);
+Expression make_line(const Expression& start, const Expression& end);
+Expression make_text(const Expression& text);
+
+// The unquoted object-name property, empty when obj has none.
+std::string object_name(const Expression& obj);
+
+// Reads the coordinates of a point object; false if obj is not one.
+bool point_coordinates(const Expression& obj, double& x, double& y);
+
+struct SampleOptions {
+	double tolerance = 5;		// degrees a joint may bend before both sides are split
+	int max_depth = 10;
+	std::size_t initial_segments = 50;
+};
+
+// Samples f over [lower, upper], bisecting the segments around every joint that
+// bends by more than the tolerance, and returns the curve as make-line objects.
+// Each round of new samples is evaluated in parallel on the current pool.
+Result continuous_plot(const std::function<Expected<double>(double)>& f,
+	double lower, double upper, const SampleOptions& options);
@@ -1,23 +1,75 @@
 #pragma once
 
+#include "budget.h"
 #include "environment.h"
 #include "expression.h"
+#include "memory.h"
 #include "parse.h"
 #include "semantic_error.h"
+#include "stats.h"
+#include "thread_pool.h"
 
 #include <istream>
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <optional>
 
 class Interpreter
 {
 public:
 	Interpreter();
+	explicit Interpreter(std::size_t threads);
 	bool parseStream(std::istream& text);
 	bool interpret(std::string& text);
 	Expression evaluate();
+	Result try_evaluate();
+	// Evaluates an already parsed program in place of the last one parsed.
+	Result try_evaluate(const Expression& program);
+
+	// Binds sym as (define sym value) would, without evaluating anything.
+	[[nodiscard]] std::optional<Error> bind(const Atom& sym, const Expression& value);
+	// What sym is defined as, or nullopt if nothing defined it.
+	[[nodiscard]] std::optional<Expression> binding(const Atom& sym) const;
+
+	// Parses and evaluates program in a fork of this interpreter, so that
+	// nothing it defines is kept. Parse failures come back as an Error.
+	Result run_isolated(const std::string& program);
+
+	// Limits applied to every later evaluation, and inherited by forks.
+	void set_limits(const Limits& limits);
+	[[nodiscard]] const Limits& limits() const noexcept;
+
+	// Stops the evaluation in progress, from another thread or a signal
+	// handler; false when nothing is being evaluated.
+	bool interrupt() noexcept;
+
+	// Bytes held for this interpreter: its definitions, parsed programs and
+	// anything its evaluations allocated and have not yet freed. A fork has
+	// an account of its own, so what it shares with its parent is counted
+	// only against the parent.
+	[[nodiscard]] MemoryUsage memory() const noexcept;
+	// What the most recent evaluation cost.
+	[[nodiscard]] const FormMemory& last_form_memory() const noexcept;
+
+	// The runtime counters, which cover every interpreter in the process, and
+	// a reset so that a single evaluation can be measured.
+	[[nodiscard]] stats::Snapshot stats() const noexcept;
+	void reset_stats() noexcept;
+
+	// A new session starting from this one's definitions. Bindings are shared
+	// copy-on-write and the worker pool is shared, so forking copies at most
+	// O(log n) bindings, amortized, as Environment::fork merges its layers.
+	Interpreter fork();
 private:
+	Interpreter(Environment env, std::shared_ptr<ThreadPool> pool, const Limits& limits);
+
 	Environment env;
 	Expression ast;
+	std::shared_ptr<ThreadPool> pool;
+	Limits budget_limits;
+	std::shared_ptr<Cancellation> cancellation = std::make_shared<Cancellation>();
+	std::shared_ptr<MemoryAccount> account;
+	FormMemory form_memory;
 };
 
@@ -2,13 +2,19 @@
 #include <csignal>
 #include <signal.h>
 
-sig_atomic_t global_status_flag = 0;
+inline volatile sig_atomic_t global_status_flag = 0;
+
+// Asked first on Ctrl+C; true when it stopped an evaluation in progress,
+// in which case nothing else happens.
+inline bool (*interrupt_evaluation)() = nullptr;
 
 #if defined(_WIN64) || defined(_WIN32)
 #include <windows.h>
-BOOL WINAPI interrupt_handler(DWORD fdwCtrlType) {
+inline BOOL WINAPI interrupt_handler(DWORD fdwCtrlType) {
     switch (fdwCtrlType) {
     case CTRL_C_EVENT:
+		if (interrupt_evaluation != nullptr && interrupt_evaluation())
+			return TRUE;
 		if(global_status_flag++ > 0)
 			exit(EXIT_FAILURE);
         return TRUE;
@@ -23,8 +29,17 @@ inline void install_handler() { SetConsoleCtrlHandler(interrupt_handler, TRUE);
 #elif defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
 #include <unistd.h>
 
-void interrupt_handler(int signal_num) {
+// A Ctrl+C that stops nothing sets global_status_flag, and the REPL returns
+// normally, flushing its output and writing the --profile file. A second one
+// ends the process at once with _exit: it is for a program that did not stop
+// for the first, and neither flushing std::cout nor writing the profile is
+// safe inside a signal handler, so buffered output and the profile are lost.
+inline void interrupt_handler(int signal_num) {
     if (signal_num == SIGINT) {
+        if (interrupt_evaluation != nullptr && interrupt_evaluation())
+            return;
+        if (global_status_flag != 0)
+            _exit(EXIT_FAILURE);
         global_status_flag = 1;
     }
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "expression.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Whole-list numeric kernels used by map and the element-wise arithmetic
+// builtins. Each kernel picks an AVX2 implementation at runtime when the CPU
+// supports it and falls back to a scalar loop otherwise.
+namespace kernels {
+
+	enum class UnaryOp { Sqrt, Sin, Cos, Tan, Ln, Log };
+	enum class BinaryOp { Add, Sub, Mul, Div };
+
+	// Maps a builtin procedure name onto its kernel, false if there is none.
+	bool unary_op(const std::string& name, UnaryOp& op);
+
+	// True when the kernel gives the same answer as the builtin for every value.
+	bool in_domain(UnaryOp op, const std::vector<double>& values);
+
+	void unary(UnaryOp op, const double* in, double* out, std::size_t n);
+	void binary(BinaryOp op, const double* left, const double* right, double* out, std::size_t n);
+
+	// Neumaier-compensated running sum.
+	struct Accumulator {
+		double sum = 0;
+		double compensation = 0;
+
+		void add(double value);
+		void add(const Accumulator& other);
+		[[nodiscard]] double value() const;
+	};
+
+	Accumulator sum(const double* in, std::size_t n);
+	double product(const double* in, std::size_t n);
+	double min(const double* in, std::size_t n);
+	double max(const double* in, std::size_t n);
+
+	// Extracts the values of a list holding only real numbers.
+	bool as_numbers(const Expression& list, std::vector<double>& values);
+	Expression to_list(std::vector<double> values);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+struct MemoryUsage {
+	// bytes allocated and not yet freed
+	std::size_t current = 0;
+	// the most held at once since the account was opened or its peak was reset
+	std::size_t peak = 0;
+};
+
+// What evaluating one top-level form cost, measured from what the
+// interpreter held when it started.
+struct FormMemory {
+	// the most held at once during the evaluation, above the starting point
+	std::size_t peak = 0;
+	// still held afterwards, the result included; negative when the form
+	// freed more than it kept, as when redefining a large binding
+	std::ptrdiff_t retained = 0;
+};
+
+// Bytes allocated on behalf of one interpreter. Only what the interpreter
+// owns is charged: expression tails, packed lists, properties and the
+// environment's bindings, through memory::allocate, memory::Allocator and
+// memory::Charge below. An allocation is charged to the account bound to the
+// calling thread and credited back to it from whichever thread frees it.
+// Allocations made anywhere else in the process are never seen.
+//
+// The limit is not enforced here: an allocation over it still succeeds and
+// the evaluation's Budget stops at its next step, so no builtin is left
+// half-done by a failed allocation.
+class MemoryAccount {
+public:
+	// An account that lives until the returned pointer and every block
+	// charged to it are gone.
+	static std::shared_ptr<MemoryAccount> open(std::size_t limit = 0);
+
+	MemoryAccount(const MemoryAccount&) = delete;
+	MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+	[[nodiscard]] MemoryUsage usage() const noexcept;
+
+	// Starts the peak over from the current usage.
+	void reset_peak() noexcept;
+
+	// Zero leaves the account unlimited.
+	void set_limit(std::size_t bytes) noexcept;
+	[[nodiscard]] std::size_t limit() const noexcept;
+
+	// Holding more than the limit.
+	[[nodiscard]] bool exceeded() const noexcept;
+	// Whether bytes more would stay within the limit.
+	[[nodiscard]] bool admits(std::size_t bytes) const noexcept;
+
+	// Account bound to the calling thread, or nullptr.
+	static MemoryAccount* current() noexcept;
+
+	class Scope {
+	public:
+		explicit Scope(MemoryAccount* account) noexcept;
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		MemoryAccount* previous;
+	};
+
+	// Used by memory::allocate and memory::Charge.
+	void charge(std::size_t bytes) noexcept;
+	void credit(std::size_t bytes) noexcept;
+
+private:
+	explicit MemoryAccount(std::size_t limit) noexcept;
+
+	void release() noexcept;
+
+	std::atomic<std::size_t> held{0};
+	std::atomic<std::size_t> most{0};
+	std::atomic<std::size_t> cap;
+	// the owner plus one per live block
+	std::atomic<std::size_t> references{1};
+};
+
+namespace memory {
+
+	// A heap block charged to the calling thread's account, if one is bound.
+	[[nodiscard]] void* allocate(std::size_t bytes);
+	void deallocate(void* block) noexcept;
+
+	// For the containers the interpreter owns; charges like allocate.
+	template <class T>
+	struct Allocator {
+		using value_type = T;
+
+		Allocator() noexcept = default;
+		template <class U>
+		Allocator(const Allocator<U>&) noexcept {}
+
+		T* allocate(std::size_t n) {
+			return static_cast<T*>(memory::allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T* block, std::size_t) noexcept {
+			memory::deallocate(block);
+		}
+
+		template <class U>
+		bool operator==(const Allocator<U>&) const noexcept {
+			return true;
+		}
+	};
+
+	// Storage the interpreter takes over from elsewhere, such as a vector built
+	// by a kernel and moved into a packed list: charged to the calling
+	// thread's account while the Charge lives.
+	class Charge {
+	public:
+		explicit Charge(std::size_t bytes = 0) noexcept;
+		~Charge();
+
+		Charge(const Charge&) = delete;
+		Charge& operator=(const Charge&) = delete;
+
+	private:
+		MemoryAccount* account;
+		std::size_t bytes;
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "expression.h"
+#include "memory.h"
+
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Contiguous storage for a list whose items are all numbers. Reals live in one
+// double array; a complex list adds a parallel array of imaginary parts.
+// Values are stored the way Atom would hold them, so printing and comparison
+// match an ordinary list item for item.
+class NumericVector {
+public:
+	NumericVector() = default;
+	explicit NumericVector(std::vector<double> real);
+	NumericVector(std::vector<double> real, std::vector<double> imag);
+
+	[[nodiscard]] std::size_t size() const noexcept;
+	[[nodiscard]] bool isComplex() const noexcept;
+
+	[[nodiscard]] Atom at(std::size_t i) const;
+	[[nodiscard]] const std::vector<double>& reals() const noexcept;
+	[[nodiscard]] const std::vector<double>& imags() const noexcept;
+
+	// One Expression per item, built on first use for code that walks list tails.
+	[[nodiscard]] const std::vector<Expression, memory::Allocator<Expression>>& expanded() const;
+
+	// Packs items when every one of them is a plain number, otherwise nullptr.
+	static std::shared_ptr<const NumericVector> pack(std::span<const Expression> items);
+
+private:
+	std::vector<double> re;
+	std::vector<double> im;
+	// the arrays arrive already built, so they are charged by size
+	memory::Charge charge;
+
+	mutable std::once_flag expand_once;
+	mutable std::vector<Expression, memory::Allocator<Expression>> items;
+};
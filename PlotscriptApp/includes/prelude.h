@@ -0,0 +1,22 @@
+#pragma once
+
+#include "expression.h"
+
+#include <cstddef>
+
+// One node of the startup prelude, flattened in pre-order. The table is
+// generated from startup.script at build time by prelude_gen, so starting an
+// interpreter needs neither the script file nor the tokenizer and parser.
+struct PreludeNode {
+	enum Kind { Symbol, Number };
+
+	Kind kind;
+	const char* symbol;
+	double number;
+	std::size_t children;
+	// set on a symbol written as (f), which the parser marks as an empty call
+	bool empty_call;
+};
+
+// Rebuilds the expression held in a generated pre-order table.
+Expression build_prelude(const PreludeNode* nodes, std::size_t count);
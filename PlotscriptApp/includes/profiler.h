@@ -0,0 +1,95 @@
+#pragma once
+
+#include "atom.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sampling profiler for Plotscript code: plotscript --profile. Every
+// procedure call pushes a frame naming the lambda, builtin or special form
+// onto a call stack kept per thread, and a CPU-time timer signal copies the
+// stack of whichever thread it lands on into that thread's sample buffer.
+// Nothing is timed per call; inclusive and exclusive times come from how
+// often a procedure is on the stack or on top of it when a sample is taken.
+//
+// When the profiler is not running, a frame costs one relaxed atomic load.
+namespace profiler {
+
+	struct Thread;
+
+	// Starts sampling every interval of process CPU time, clearing what an
+	// earlier session collected; false where there is no profiling timer.
+	bool start(std::chrono::microseconds interval = std::chrono::microseconds(1000));
+	void stop();
+	[[nodiscard]] bool active() noexcept;
+
+	struct Procedure {
+		std::string name;
+		std::uint64_t calls = 0;
+		// samples with the procedure anywhere on the stack, and on top of it
+		std::uint64_t inclusive = 0;
+		std::uint64_t exclusive = 0;
+	};
+
+	struct Profile {
+		// the interval asked for; the timer's resolution may stretch it
+		std::chrono::microseconds interval{0};
+		// process CPU time between start() and stop(), which the samples divide
+		std::chrono::microseconds cpu{0};
+		std::uint64_t samples = 0;
+		// samples lost because a thread's buffer was full
+		std::uint64_t dropped = 0;
+		// one entry per distinct stack, outermost frame first, joined by ';'
+		std::vector<std::pair<std::string, std::uint64_t>> folded;
+		// by exclusive samples, most first
+		std::vector<Procedure> procedures;
+	};
+
+	// Everything sampled since start(); call after stop().
+	Profile collect();
+
+	// Folded stacks, one "a;b;c count" line each, as flamegraph.pl reads them.
+	void write_folded(std::ostream& out, const Profile& profile);
+	// Calls and inclusive and exclusive time per procedure.
+	void write_summary(std::ostream& out, const Profile& profile);
+
+	// A procedure on the calling thread's Plotscript stack while it lives.
+	class Frame {
+	public:
+		explicit Frame(std::string_view name);
+		// a lambda, named by the symbol it was called through
+		explicit Frame(const Atom& name);
+		~Frame();
+
+		Frame(const Frame&) = delete;
+		Frame& operator=(const Frame&) = delete;
+	private:
+		void push(std::string_view name);
+		Thread* thread = nullptr;
+	};
+
+	// The calling thread's stack, so work handed to another thread can be
+	// attributed to the frames that started it; empty when not profiling.
+	using Stack = std::vector<std::uint32_t>;
+	[[nodiscard]] Stack capture();
+
+	// Puts a captured stack under the calling thread's frames while it lives,
+	// without counting the frames as calls. A thread that is already inside
+	// a procedure, such as the caller helping with its own parallel_for,
+	// keeps the stack it has.
+	class Adopt {
+	public:
+		explicit Adopt(const Stack& stack);
+		~Adopt();
+
+		Adopt(const Adopt&) = delete;
+		Adopt& operator=(const Adopt&) = delete;
+	private:
+		Thread* thread = nullptr;
+		std::size_t count = 0;
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "semantic_error.h"
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+// Why an evaluation was stopped from outside the program: by one of its
+// Limits or by a cancellation. None for an error in the program itself.
+enum class Stop : std::uint8_t { None, Fuel, Deadline, Memory, Allocation, Cancelled };
+
+// An evaluation error passed back as a value. Errors only become a
+// SemanticError at the public eval/evaluate boundary, so code that probes
+// many failing inputs does not pay for unwinding on every one.
+class Error {
+public:
+	explicit Error(std::string message, Stop stop = Stop::None) : m_message(std::move(message)), m_stop(stop) {}
+
+	[[nodiscard]] const std::string& message() const noexcept { return m_message; }
+	[[nodiscard]] Stop stop() const noexcept { return m_stop; }
+
+	// Prepends context the way the evaluator used to when rethrowing. A stop
+	// is not the failure of the call it happened in, so it is left as it is.
+	[[nodiscard]] Error within(const std::string& context) const {
+		return m_stop != Stop::None ? *this : Error(context + m_message);
+	}
+
+private:
+	std::string m_message;
+	Stop m_stop;
+};
+
+// Thrown in place of a SemanticError for an error with a Stop.
+class EvaluationStopped : public SemanticError {
+public:
+	EvaluationStopped(const std::string& msg, Stop reason) : SemanticError(msg), reason(reason) {}
+
+	const Stop reason;
+};
+
+template <typename T>
+class Expected {
+public:
+	Expected() : m_data(std::in_place_index<0>) {}
+	Expected(const T& value) : m_data(std::in_place_index<0>, value) {} //NOLINT
+	Expected(T&& value) : m_data(std::in_place_index<0>, std::move(value)) {} //NOLINT
+	Expected(Error error) : m_data(std::in_place_index<1>, std::move(error)) {} //NOLINT
+
+	// Lets builtins keep writing `return { value };` and `return { head, items };`.
+	template <typename U>
+		requires (std::is_constructible_v<T, U> && !std::is_same_v<std::remove_cvref_t<U>, T>
+			&& !std::is_same_v<std::remove_cvref_t<U>, Expected> && !std::is_same_v<std::remove_cvref_t<U>, Error>)
+	Expected(U&& value) : m_data(std::in_place_index<0>, std::forward<U>(value)) {} //NOLINT
+
+	template <typename A, typename B, typename... Rest>
+		requires std::is_constructible_v<T, A, B, Rest...>
+	Expected(A&& a, B&& b, Rest&&... rest)
+		: m_data(std::in_place_index<0>, std::forward<A>(a), std::forward<B>(b), std::forward<Rest>(rest)...) {}
+
+	[[nodiscard]] bool has_value() const noexcept { return m_data.index() == 0; }
+	explicit operator bool() const noexcept { return has_value(); }
+
+	[[nodiscard]] T& value() & { return std::get<0>(m_data); }
+	[[nodiscard]] const T& value() const& { return std::get<0>(m_data); }
+	[[nodiscard]] T&& value() && { return std::get<0>(std::move(m_data)); }
+
+	T& operator*() & { return value(); }
+	const T& operator*() const& { return value(); }
+	T* operator->() { return &value(); }
+	const T* operator->() const { return &value(); }
+
+	[[nodiscard]] const Error& error() const { return std::get<1>(m_data); }
+
+	// The value, or the error thrown as a SemanticError.
+	T value_or_throw() && {
+		if (!has_value() && error().stop() != Stop::None)
+			throw EvaluationStopped(error().message(), error().stop());
+		if (!has_value())
+			throw SemanticError(error().message());
+		return std::get<0>(std::move(m_data));
+	}
+
+private:
+	std::variant<T, Error> m_data;
+};
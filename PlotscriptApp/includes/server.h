@@ -0,0 +1,147 @@
+#pragma once
+
+#include "interpreter.h"
+#include "result.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Messages on the daemon socket are a 4-byte big-endian length followed by
+// that many bytes. A request is the text of a program; a response is a status
+// byte followed by the printed result or the error message. Responses come
+// back in request order, so a client may send many requests before reading.
+namespace wire {
+
+	enum class Status : char { Ok = 'O', Error = 'E' };
+
+	// Longest message either side accepts.
+	constexpr std::size_t MAX_MESSAGE = std::size_t(64) << 20;
+
+	void append_message(std::string& out, std::string_view payload);
+
+	enum class Take { Message, Incomplete, TooLong };
+
+	// Reads the message starting at offset in buffer and advances offset past it.
+	Take take_message(const std::string& buffer, std::size_t& offset, std::string& payload);
+}
+
+// Blocking client for the daemon, used by plotscript --client and the
+// benchmarks.
+class Client {
+public:
+	struct Response {
+		bool ok = false;
+		std::string text;
+	};
+
+	explicit Client(const std::string& path);
+	~Client();
+
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	[[nodiscard]] bool is_open() const noexcept;
+
+	bool send(std::string_view program);
+	// The response to the oldest unanswered request; nullopt if the connection failed.
+	std::optional<Response> receive();
+
+private:
+	int fd = -1;
+	std::string buffer;
+	std::size_t offset = 0;
+};
+
+// plotscript --serve: keeps warm interpreters in memory and evaluates requests
+// from a Unix domain socket. One thread does all socket I/O through epoll; a
+// fixed set of workers, each with its own Interpreter, evaluates the programs.
+// Every request runs in a fresh fork of its worker's interpreter, so requests
+// never see each other's definitions.
+class Server {
+public:
+	// limits apply to every request
+	Server(std::string path, std::size_t workers, std::size_t threads, const Limits& limits = {});
+	~Server();
+
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	// Listens on the socket and serves until stop() is called.
+	std::optional<Error> run();
+
+	// Safe to call from any thread and from a signal handler.
+	void stop() noexcept;
+
+private:
+	struct Job {
+		std::uint64_t client;
+		std::uint64_t sequence;
+		std::string program;
+	};
+
+	struct Done {
+		std::uint64_t client;
+		std::uint64_t sequence;
+		std::string response;
+	};
+
+	struct Connection {
+		int fd = -1;
+		std::string input;
+		std::size_t input_offset = 0;
+		std::string output;
+		std::size_t output_offset = 0;
+		std::uint64_t next_request = 0;
+		std::uint64_t next_response = 0;
+		// responses finished out of order, by sequence number
+		std::map<std::uint64_t, std::string> finished;
+		std::size_t finished_bytes = 0;
+		// the client shut down its side; close once every response is sent
+		bool draining = false;
+		std::uint32_t events = 0;
+
+		// Whether too many requests or too many response bytes are waiting
+		// on the client for the server to read more from it.
+		[[nodiscard]] bool saturated() const noexcept;
+	};
+
+	std::optional<Error> listen();
+	void work(Interpreter interp);
+	void accept_clients();
+	void read_client(std::uint64_t id);
+	void write_client(std::uint64_t id);
+	void queue_requests(std::uint64_t id);
+	void collect();
+	void update_events(std::uint64_t id);
+	void close_client(std::uint64_t id);
+	void shut_down();
+
+	std::string path;
+	Interpreter base;
+	std::size_t worker_count;
+	std::vector<std::thread> workers;
+
+	int listen_fd = -1;
+	int epoll_fd = -1;
+	int wake_fd = -1;
+	std::atomic<bool> stopping{false};
+
+	std::mutex job_lock;
+	std::condition_variable job_ready;
+	std::deque<Job> jobs;
+
+	std::mutex done_lock;
+	std::vector<Done> done;
+
+	std::map<std::uint64_t, Connection> clients;
+	std::uint64_t next_client;
+};
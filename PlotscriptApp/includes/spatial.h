@@ -0,0 +1,53 @@
+#pragma once
+
+#include "expression.h"
+#include "result.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Static R-tree over make-point and make-line objects, bulk loaded with
+// Sort-Tile-Recursive packing. Nodes are stored level by level in flat arrays:
+// node i of a level covers entries [i * FANOUT, (i + 1) * FANOUT) of the level
+// below, so the tree needs no child pointers.
+class SpatialIndex : public NativeObject {
+public:
+	static constexpr std::size_t FANOUT = 16;
+
+	struct Box {
+		double x0, y0, x1, y1;
+	};
+
+	// Builds the index over a list of graphics objects. Bounds are computed and
+	// tiles sorted in parallel when a pool is bound to the calling thread.
+	static Expected<std::shared_ptr<const SpatialIndex>> build(const Expression& objects);
+
+	// Objects touching rect, in the order they were given to build.
+	[[nodiscard]] std::vector<Expression> query(const Box& rect) const;
+
+	// Up to k objects closest to (x, y), nearest first.
+	[[nodiscard]] std::vector<Expression> nearest(double x, double y, std::size_t k) const;
+
+	[[nodiscard]] std::size_t size() const noexcept;
+
+	[[nodiscard]] std::string name() const override;
+	[[nodiscard]] std::string describe() const override;
+
+private:
+	// A point is stored as a segment with both ends at the same place.
+	struct Segment {
+		double x0, y0, x1, y1;
+	};
+
+	static bool touches(const Segment& s, const Box& rect);
+	static double distance2(const Segment& s, double x, double y);
+
+	std::vector<Expression> objects;
+	std::vector<Segment> segments;
+	// entry i of the leaf level holds object order[i]
+	std::vector<std::size_t> order;
+	// levels[0] are the leaf boxes, levels.back() the single root
+	std::vector<std::vector<Box>> levels;
+};
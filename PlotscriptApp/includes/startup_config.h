@@ -1,8 +0,0 @@
-#ifndef STARTUP_CONFIG_HPP
-#define STARTUP_CONFIG_HPP
-
-#include <string>
-
-const std::string STARTUP_FILE = "C:/Users/Hayde/Projects/Plotscript/PlotscriptApp/includes/startup.script";
-
-#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Counters of what the interpreter is doing, always compiled in. Each thread
+// bumps its own block of relaxed atomics, so a count costs one uncontended
+// add; read() sums the blocks of every thread that has counted anything.
+// The counters cover the whole process, not one interpreter.
+namespace stats {
+
+	enum Counter : std::size_t {
+		// expressions copied; their children are shared, not copied
+		ExpressionCopies,
+		// child lists copied because a shared one was about to change
+		DeepCopies,
+		// symbol lookups in an Environment and in the builtin table
+		Lookups,
+		// std::map finds made by those lookups, one per environment layer searched
+		MapFinds,
+		LambdaCalls,
+		BuiltinCalls,
+		// bytes of interpreter data allocated, as memory.h charges them
+		BytesAllocated,
+		// the most children any expression has had, packed lists aside; a
+		// maximum, not a sum
+		LongestTail,
+		COUNT
+	};
+
+	// Names used by the runtime-stats builtin, by Counter.
+	constexpr std::array<std::string_view, COUNT> NAMES = {
+		"expression-copies", "deep-copies", "lookups", "map-finds",
+		"lambda-calls", "builtin-calls", "bytes-allocated", "longest-tail",
+	};
+
+	void add(Counter counter, std::uint64_t n = 1) noexcept;
+	// Raises a maximum such as LongestTail to at least value.
+	void raise(Counter counter, std::uint64_t value) noexcept;
+
+	struct Snapshot {
+		std::array<std::uint64_t, COUNT> values{};
+
+		std::uint64_t operator[](Counter counter) const noexcept {
+			return values[counter];
+		}
+	};
+
+	Snapshot read() noexcept;
+	// Zeroes every counter. Counts made by other threads while this runs may
+	// survive it.
+	void reset() noexcept;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "expression.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streams graphics objects (make-point, make-line, make-text results, and
+// lists of them at any depth) to an SVG file. Elements are formatted straight
+// into a fixed output buffer, so memory use does not grow with the input.
+class SvgWriter {
+public:
+	explicit SvgWriter(const std::string& path);
+	~SvgWriter();
+
+	SvgWriter(const SvgWriter&) = delete;
+	SvgWriter& operator=(const SvgWriter&) = delete;
+
+	[[nodiscard]] bool is_open() const noexcept;
+
+	// Writes the whole document for objects and closes the file; returns the
+	// number of elements, or an Error if any of it could not be written.
+	Expected<std::size_t> write(const Expression& objects);
+
+private:
+	struct Bounds {
+		double left = 0, top = 0, right = 0, bottom = 0;
+		bool empty = true;
+		void add(double x, double y);
+	};
+
+	void measure(const Expression& obj, Bounds& bounds) const;
+	void emit(const Expression& obj);
+
+	void put(const char* text);
+	void put(double value);
+	void put_text(const std::string& text);
+
+	std::string path;
+	std::FILE* out = nullptr;
+	std::vector<char> buffer;
+	std::size_t count = 0;
+};
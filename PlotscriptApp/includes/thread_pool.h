@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: each worker owns a deque, pops its own work from the back
+// and steals from the front of the others when it runs dry. The workers start
+// with the first parallel_for that needs them, so an interpreter that never
+// runs anything in parallel never starts a thread.
+class ThreadPool {
+public:
+	explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Workers the pool runs once started.
+	[[nodiscard]] std::size_t size() const noexcept;
+
+	// Calls body(i) for every i in [0, count). The calling thread helps until all
+	// iterations are done; the first exception thrown by body is rethrown here.
+	void parallel_for(std::size_t count, const std::function<void(std::size_t)>& body);
+
+	// Pool bound to the calling thread, or nullptr when evaluation is serial.
+	static ThreadPool* current() noexcept;
+
+	class Scope {
+	public:
+		explicit Scope(ThreadPool* pool) noexcept;
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		ThreadPool* previous;
+	};
+
+private:
+	using Task = std::function<void()>;
+
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	void start();
+	void run_worker(std::size_t index);
+	void push(Task task);
+	bool try_run_one();
+
+	std::size_t threads;
+	std::once_flag started;
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::atomic<std::size_t> pending{0};
+	std::atomic<std::size_t> next_queue{0};
+	bool stopping = false;
+};
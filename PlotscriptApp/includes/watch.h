@@ -0,0 +1,89 @@
+#pragma once
+
+#include "batch.h"
+#include "interpreter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// plotscript --watch: re-runs a script each time it is saved, evaluating only
+// what the edit can have changed. The script is cut into forms, and a form
+// reads the definitions of the symbols it mentions, and of the symbols that
+// the lambdas among those mention, as they stand where the form is. A form is
+// evaluated again when its text is new or when something it reads now has a
+// different value; every other form keeps its result and has its definitions
+// bound again without being evaluated. The forms before the first edit are
+// not looked at at all: the session keeps a snapshot of the definitions every
+// few hundred forms and picks up from the last one before the edit.
+namespace watch {
+
+	// The forms of a script: its top-level forms, or the forms inside it when
+	// the whole script is one (begin ...).
+	std::vector<batch::Job> split(const std::string& text);
+
+	struct Failure {
+		std::size_t line;
+		std::string message;
+	};
+
+	struct Report {
+		std::size_t forms = 0;
+		// forms evaluated by this update
+		std::size_t evaluated = 0;
+		// forms whose definitions were bound again from their last run; the
+		// rest of the forms before the first edit were skipped
+		std::size_t replayed = 0;
+		// what the last form evaluated to, as a run of the whole script would
+		Result result;
+		// the evaluated forms that failed, in script order
+		std::vector<Failure> failures;
+	};
+
+	class Session {
+	public:
+		// Every update evaluates in a fork of base, so base keeps the prelude
+		// and the limits and never sees the script's definitions.
+		explicit Session(Interpreter& base);
+
+		// Brings the session up to date with text, the whole script as it now is.
+		// An interrupted update stops at the form it was evaluating, which the
+		// next update evaluates again along with every form after it.
+		Report update(const std::string& text);
+
+		// Stops the update in progress, from another thread or a signal
+		// handler; false when no update is evaluating.
+		bool interrupt() noexcept;
+
+	private:
+		struct Form {
+			std::string text;
+			std::size_t line = 0;
+			Expression program;
+			bool parsed = false;
+
+			// symbols the form may define, and every symbol it mentions
+			std::vector<Atom> defines;
+			std::vector<Atom> mentions;
+
+			// the script's definitions it read, and what its own definitions
+			// were bound to, when it last ran
+			std::vector<std::pair<Atom, Expression>> inputs;
+			std::vector<std::pair<Atom, Expression>> bindings;
+			Result outcome;
+		};
+
+		Form read(const batch::Job& job);
+
+		// forms between snapshots of the definitions
+		static constexpr std::size_t CHECKPOINT = 256;
+
+		Interpreter& base;
+		std::vector<Form> forms;
+		// checkpoints[c] holds what the forms before c * CHECKPOINT defined
+		std::vector<Interpreter> checkpoints;
+		// the interpreter the update in progress evaluates in
+		std::atomic<Interpreter*> evaluating{nullptr};
+	};
+}
@@ -1,23 +1,63 @@
 #include "interpreter.h"
-#include "includes/startup_config.h"
+#include "prelude.h"
+#include "prelude_data.h"
 
-Interpreter::Interpreter()
+Interpreter::Interpreter() : Interpreter(std::thread::hardware_concurrency())
 {
-	env = Environment();
+}
+
+Interpreter::Interpreter(std::size_t threads)
+	: pool(std::make_shared<ThreadPool>(threads)), account(MemoryAccount::open())
+{
+	// startup.script, parsed when the interpreter was built
+	ast = build_prelude(PRELUDE, std::size(PRELUDE));
+	evaluate();
+	ast = Expression();
+}
+
+Interpreter::Interpreter(Environment env, std::shared_ptr<ThreadPool> pool, const Limits& limits)
+	: env(std::move(env)), pool(std::move(pool)), budget_limits(limits), account(MemoryAccount::open(limits.max_memory))
+{
+}
+
+Interpreter Interpreter::fork() {
+	return { env.fork(), pool, budget_limits };
+}
 
-	auto stream = std::ifstream(STARTUP_FILE);
-    if (!stream.is_open())
-        throw(std::runtime_error("Could not open start up file."));
+void Interpreter::set_limits(const Limits& limits) {
+	budget_limits = limits;
+	account->set_limit(limits.max_memory);
+}
+
+const Limits& Interpreter::limits() const noexcept {
+	return budget_limits;
+}
+
+bool Interpreter::interrupt() noexcept {
+	return cancellation->cancel();
+}
+
+MemoryUsage Interpreter::memory() const noexcept {
+	return account->usage();
+}
+
+const FormMemory& Interpreter::last_form_memory() const noexcept {
+	return form_memory;
+}
 
-	if (parseStream(stream))
-		evaluate();
-	else
-		std::cerr << "Invalid starting file: " << STARTUP_FILE << std::endl;
+stats::Snapshot Interpreter::stats() const noexcept {
+	return stats::read();
+}
+
+void Interpreter::reset_stats() noexcept {
+	stats::reset();
 }
 
 bool Interpreter::parseStream(std::istream& text) {
 	if (text.bad()) return false;
 
+	MemoryAccount::Scope charging(account.get());
+
 	TokenSequence tokens = tokenize(text);
 
 	ast = parse(tokens);
@@ -31,5 +71,54 @@ bool Interpreter::interpret(std::string& text) {
 }
 
 Expression Interpreter::evaluate() {
-	return ast.eval(env);
-}
\ No newline at end of file
+	return try_evaluate().value_or_throw();
+}
+
+Result Interpreter::try_evaluate(const Expression& program) {
+	ast = program;
+	return try_evaluate();
+}
+
+std::optional<Error> Interpreter::bind(const Atom& sym, const Expression& value) {
+	MemoryAccount::Scope charging(account.get());
+	return env.try_add_exp(sym, value);
+}
+
+std::optional<Expression> Interpreter::binding(const Atom& sym) const {
+	if (!env.is_exp(sym))
+		return std::nullopt;
+	return env.get_exp(sym);
+}
+
+Result Interpreter::try_evaluate() {
+	ThreadPool::Scope scope(pool.get());
+	Budget budget(budget_limits, cancellation.get(), account.get());
+	Budget::Scope budgeting(&budget);
+
+	std::size_t before = account->usage().current;
+	account->reset_peak();
+
+	Result result;
+	{
+		MemoryAccount::Scope charging(account.get());
+		result = ast.evaluate(env);
+	}
+
+	MemoryUsage after = account->usage();
+	form_memory.peak = after.peak - before;
+	form_memory.retained = static_cast<std::ptrdiff_t>(after.current) - static_cast<std::ptrdiff_t>(before);
+	return result;
+}
+Result Interpreter::run_isolated(const std::string& program) {
+	Interpreter session = fork();
+	std::istringstream stream(program);
+	if (!session.parseStream(stream))
+		return Error("Invalid Program. Could not parse.");
+
+	try {
+		return session.try_evaluate();
+	}
+	catch (std::exception& e) {
+		return Error(e.what());
+	}
+}
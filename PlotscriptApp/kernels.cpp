@@ -0,0 +1,260 @@
+#include "kernels.h"
+#include "packed.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PLOTSCRIPT_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+
+bool unary_op(const std::string& name, UnaryOp& op) {
+	if (name == "sqrt") op = UnaryOp::Sqrt;
+	else if (name == "sin") op = UnaryOp::Sin;
+	else if (name == "cos") op = UnaryOp::Cos;
+	else if (name == "tan") op = UnaryOp::Tan;
+	else if (name == "ln") op = UnaryOp::Ln;
+	else if (name == "log") op = UnaryOp::Log;
+	else return false;
+
+	return true;
+}
+
+bool in_domain(UnaryOp op, const std::vector<double>& values) {
+	switch (op) {
+		case UnaryOp::Sqrt:
+		case UnaryOp::Ln:
+		case UnaryOp::Log:
+			// negative inputs give a complex root or an error, leave those to the builtin
+			return std::none_of(values.begin(), values.end(), [](double v) { return v < 0; });
+		default:
+			return true;
+	}
+}
+
+namespace {
+
+	void unary_scalar(UnaryOp op, const double* in, double* out, std::size_t n) {
+		switch (op) {
+			case UnaryOp::Sqrt:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::sqrt(in[i]);
+				break;
+			case UnaryOp::Sin:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::sin(in[i]);
+				break;
+			case UnaryOp::Cos:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::cos(in[i]);
+				break;
+			case UnaryOp::Tan:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::tan(in[i]);
+				break;
+			case UnaryOp::Ln:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::log(in[i]);
+				break;
+			case UnaryOp::Log:
+				for (std::size_t i = 0; i < n; i++) out[i] = std::log10(in[i]);
+				break;
+		}
+	}
+
+	void binary_scalar(BinaryOp op, const double* left, const double* right, double* out, std::size_t n) {
+		switch (op) {
+			case BinaryOp::Add:
+				for (std::size_t i = 0; i < n; i++) out[i] = left[i] + right[i];
+				break;
+			case BinaryOp::Sub:
+				for (std::size_t i = 0; i < n; i++) out[i] = left[i] - right[i];
+				break;
+			case BinaryOp::Mul:
+				for (std::size_t i = 0; i < n; i++) out[i] = left[i] * right[i];
+				break;
+			case BinaryOp::Div:
+				for (std::size_t i = 0; i < n; i++) out[i] = left[i] / right[i];
+				break;
+		}
+	}
+
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	bool have_avx2() {
+		static const bool supported = __builtin_cpu_supports("avx2");
+		return supported;
+	}
+
+	__attribute__((target("avx2")))
+	void sqrt_avx2(const double* in, double* out, std::size_t n) {
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(in + i)));
+		unary_scalar(UnaryOp::Sqrt, in + i, out + i, n - i);
+	}
+
+	__attribute__((target("avx2")))
+	void binary_avx2(BinaryOp op, const double* left, const double* right, double* out, std::size_t n) {
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d a = _mm256_loadu_pd(left + i);
+			__m256d b = _mm256_loadu_pd(right + i);
+			__m256d r;
+			switch (op) {
+				case BinaryOp::Add: r = _mm256_add_pd(a, b); break;
+				case BinaryOp::Sub: r = _mm256_sub_pd(a, b); break;
+				case BinaryOp::Mul: r = _mm256_mul_pd(a, b); break;
+				default: r = _mm256_div_pd(a, b); break;
+			}
+			_mm256_storeu_pd(out + i, r);
+		}
+		binary_scalar(op, left + i, right + i, out + i, n - i);
+	}
+
+	__attribute__((target("avx2")))
+	Accumulator sum_avx2(const double* in, std::size_t n) {
+		// four independent Kahan lanes, folded together with Neumaier at the end
+		__m256d total = _mm256_setzero_pd();
+		__m256d error = _mm256_setzero_pd();
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d y = _mm256_sub_pd(_mm256_loadu_pd(in + i), error);
+			__m256d t = _mm256_add_pd(total, y);
+			error = _mm256_sub_pd(_mm256_sub_pd(t, total), y);
+			total = t;
+		}
+
+		double lanes[4], errors[4];
+		_mm256_storeu_pd(lanes, total);
+		_mm256_storeu_pd(errors, error);
+
+		Accumulator result;
+		for (int k = 0; k < 4; k++) {
+			result.add(lanes[k]);
+			result.add(-errors[k]);
+		}
+		for (; i < n; i++)
+			result.add(in[i]);
+		return result;
+	}
+
+	__attribute__((target("avx2")))
+	double extreme_avx2(const double* in, std::size_t n, bool minimum) {
+		__m256d best = _mm256_set1_pd(in[0]);
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d v = _mm256_loadu_pd(in + i);
+			best = minimum ? _mm256_min_pd(best, v) : _mm256_max_pd(best, v);
+		}
+
+		double lanes[4];
+		_mm256_storeu_pd(lanes, best);
+		double result = lanes[0];
+		for (int k = 1; k < 4; k++)
+			result = minimum ? std::min(result, lanes[k]) : std::max(result, lanes[k]);
+		for (; i < n; i++)
+			result = minimum ? std::min(result, in[i]) : std::max(result, in[i]);
+		return result;
+	}
+#endif
+}
+
+void Accumulator::add(double value) {
+	double t = sum + value;
+	if (std::fabs(sum) >= std::fabs(value))
+		compensation += (sum - t) + value;
+	else
+		compensation += (value - t) + sum;
+	sum = t;
+}
+
+void Accumulator::add(const Accumulator& other) {
+	add(other.sum);
+	compensation += other.compensation;
+}
+
+double Accumulator::value() const {
+	return sum + compensation;
+}
+
+Accumulator sum(const double* in, std::size_t n) {
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	if (have_avx2())
+		return sum_avx2(in, n);
+#endif
+	Accumulator result;
+	for (std::size_t i = 0; i < n; i++)
+		result.add(in[i]);
+	return result;
+}
+
+double product(const double* in, std::size_t n) {
+	double result = 1;
+	for (std::size_t i = 0; i < n; i++)
+		result *= in[i];
+	return result;
+}
+
+double min(const double* in, std::size_t n) {
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	if (n > 0 && have_avx2())
+		return extreme_avx2(in, n, true);
+#endif
+	return *std::min_element(in, in + n);
+}
+
+double max(const double* in, std::size_t n) {
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	if (n > 0 && have_avx2())
+		return extreme_avx2(in, n, false);
+#endif
+	return *std::max_element(in, in + n);
+}
+
+void unary(UnaryOp op, const double* in, double* out, std::size_t n) {
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	// AVX2 has no transcendental instructions, those stay on the scalar libm loop
+	if (op == UnaryOp::Sqrt && have_avx2()) {
+		sqrt_avx2(in, out, n);
+		return;
+	}
+#endif
+	unary_scalar(op, in, out, n);
+}
+
+void binary(BinaryOp op, const double* left, const double* right, double* out, std::size_t n) {
+#ifdef PLOTSCRIPT_HAVE_AVX2
+	if (have_avx2()) {
+		binary_avx2(op, left, right, out, n);
+		return;
+	}
+#endif
+	binary_scalar(op, left, right, out, n);
+}
+
+bool as_numbers(const Expression& list, std::vector<double>& values) {
+	if (list.head().toString() != "list")
+		return false;
+
+	if (const NumericVector* packed = list.packed()) {
+		if (packed->isComplex())
+			return false;
+		values = packed->reals();
+		return true;
+	}
+
+	values.clear();
+	for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); it++) {
+		if (!it->head().isNumber() || it->tailConstBegin() != it->tailConstEnd())
+			return false;
+		values.push_back(it->head().asNumber());
+	}
+	return true;
+}
+
+Expression to_list(std::vector<double> values) {
+	if (values.empty())
+		return { Atom("list"), {} };
+
+	return Expression(std::make_shared<const NumericVector>(std::move(values)));
+}
+
+}
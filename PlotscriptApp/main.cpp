@@ -1,24 +1,87 @@
+#include "batch.h"
 #include "interpreter.h"
 #include "interrupt_handler.h"
+#include "profiler.h"
+#include "server.h"
+#include "svg.h"
+#include "watch.h"
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
 
-int eval_from_stream(std::istream& stream, Interpreter& interp) {
+
+// --mem-report: after each evaluation, what it cost and what the interpreter holds
+bool memory_report = false;
+
+void report_memory(const Interpreter& interp) {
+    if (!memory_report)
+        return;
+
+    const FormMemory& form = interp.last_form_memory();
+    MemoryUsage total = interp.memory();
+    std::cerr << "memory: form peak " << form.peak << " bytes, retained " << form.retained
+        << " bytes; interpreter holds " << total.current << " bytes\n";
+}
+
+// --profile: folded stacks go to this file at exit, the summary to stderr
+std::string profile_path;
+
+void write_profile() {
+    profiler::stop();
+    profiler::Profile profile = profiler::collect();
+
+    std::ofstream out(profile_path);
+    if (!out) {
+        std::cerr << "Could not open " << profile_path << " for writing.\n";
+        return;
+    }
+    profiler::write_folded(out, profile);
+    profiler::write_summary(std::cerr, profile);
+}
+
+int eval_from_stream(std::istream& stream, Interpreter& interp, const std::string& svg_path = "") {
 
     if (!interp.parseStream(stream)) {
         std::cerr << "Invalid Program. Could not parse.\n";
         return EXIT_FAILURE;
     }
     try {
-        std::cout << interp.evaluate() << "\n";
+        Expression result = interp.evaluate();
+        report_memory(interp);
+
+        if (svg_path.empty()) {
+            std::cout << result << "\n";
+        }
+        else {
+            SvgWriter svg(svg_path);
+            if (!svg.is_open()) {
+                std::cerr << "Could not open " << svg_path << " for writing.\n";
+                return EXIT_FAILURE;
+            }
+            auto written = svg.write(result);
+            if (!written) {
+                std::cerr << written.error().message() << "\n";
+                return EXIT_FAILURE;
+            }
+            std::cerr << "Wrote " << *written << " objects to " << svg_path << "\n";
+        }
     }
     catch (SemanticError& e) {
+        report_memory(interp);
         std::cerr << e.what();
     }
 
     return EXIT_SUCCESS;
 }
 
-int eval_from_file(const std::string& filename, Interpreter& interp) {
+int eval_from_file(const std::string& filename, Interpreter& interp, const std::string& svg_path = "") {
 
     std::ifstream ifs(filename);
 
@@ -27,12 +90,12 @@ int eval_from_file(const std::string& filename, Interpreter& interp) {
         return EXIT_FAILURE;
     }
 
-    return eval_from_stream(ifs, interp);
+    return eval_from_stream(ifs, interp, svg_path);
 }
 
-int eval_from_command(const std::string& arg_exp, Interpreter& interp) {
+int eval_from_command(const std::string& arg_exp, Interpreter& interp, const std::string& svg_path = "") {
     std::istringstream expression(arg_exp);
-    return eval_from_stream(expression, interp);
+    return eval_from_stream(expression, interp, svg_path);
 }
 
 void repl(Interpreter& interp) {
@@ -64,8 +127,10 @@ void repl(Interpreter& interp) {
         else {
             try {
                 std::cout << interp.evaluate();
+                report_memory(interp);
             }
             catch (SemanticError& e) {
+                 report_memory(interp);
                  std::cout << e.what();
             }
         }
@@ -73,28 +138,300 @@ void repl(Interpreter& interp) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    Interpreter start;
+// Prints one line per job, in input order; failed jobs print their error.
+int run_batch(const std::string& filename, std::size_t workers, std::size_t threads, const Limits& limits) {
+    std::ifstream ifs(filename);
+    if (!ifs) {
+        std::cerr << "Could not open file for reading.\n";
+        return EXIT_FAILURE;
+    }
+    std::string text(std::istreambuf_iterator<char>(ifs), {});
 
-    if (argc == 1) {
-        repl(start);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<batch::Job> jobs = batch::split(text);
+    Interpreter warm(threads);
+    warm.set_limits(limits);
+
+    std::size_t failed = 0;
+    batch::run(jobs, warm, workers, [&](std::size_t, const batch::Outcome& outcome) {
+        failed += outcome.ok ? 0 : 1;
+        std::cout << outcome.text << "\n";
+    });
+    std::cout.flush();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << jobs.size() << " jobs, " << failed << " failed, in " << seconds << " s: "
+        << static_cast<double>(jobs.size()) / seconds << " jobs/s on " << workers << " workers\n";
+    return EXIT_SUCCESS;
+}
+
+// Re-runs the file whenever it changes until Ctrl+C, printing the result of
+// its last form and the errors of the forms that were evaluated.
+int watch_file(const std::string& filename, std::size_t threads, const Limits& limits) {
+    Interpreter base(threads);
+    base.set_limits(limits);
+    watch::Session session(base);
+
+    // Ctrl+C stops an update in progress; while waiting for a change, or if
+    // the update is already stopping, it ends the loop
+    static watch::Session* watching = &session;
+    interrupt_evaluation = [] { return watching->interrupt(); };
+    install_handler();
+
+    std::filesystem::file_time_type seen{};
+    bool first = true;
+    while (global_status_flag == 0) {
+        std::error_code error;
+        auto modified = std::filesystem::last_write_time(filename, error);
+        if (error) {
+            if (first) {
+                std::cerr << "Could not open file for reading.\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (first || modified != seen) {
+            std::ifstream ifs(filename);
+            std::string text(std::istreambuf_iterator<char>(ifs), {});
+            seen = modified;
+            first = false;
+
+            auto start = std::chrono::steady_clock::now();
+            watch::Report report = session.update(text);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            for (const auto& failure : report.failures)
+                std::cerr << filename << ":" << failure.line << ": " << failure.message << "\n";
+            if (report.result)
+                std::cout << *report.result << std::endl;
+            std::cerr << "Evaluated " << report.evaluated << " of " << report.forms << " forms in " << ms << " ms.\n";
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return EXIT_SUCCESS;
+}
+
+Server* active_server = nullptr;
+
+void stop_server(int) {
+    if (active_server != nullptr)
+        active_server->stop();
+}
+
+int serve(const std::string& path, std::size_t workers, std::size_t threads, const Limits& limits) {
+    Server server(path, workers, threads, limits);
+
+    active_server = &server;
+    std::signal(SIGINT, stop_server);
+    std::signal(SIGTERM, stop_server);
+
+    auto error = server.run();
+    active_server = nullptr;
+
+    if (error) {
+        std::cerr << error->message() << "\n";
+        return EXIT_FAILURE;
     }
-    if (argc == 2) {
-        return eval_from_command(argv[1], start);
+    return EXIT_SUCCESS;
+}
+
+// Sends each program to the server before reading any response; the
+// responses come back in the same order.
+int client(const std::string& path, const std::vector<std::string>& programs) {
+    Client connection(path);
+    if (!connection.is_open()) {
+        std::cerr << "Could not connect to " << path << ".\n";
+        return EXIT_FAILURE;
     }
-    else if (argc == 3) {
-        if (std::string(argv[1]) == "-e") {
-            return eval_from_command(argv[2], start);
+
+    for (const auto& program : programs) {
+        if (!connection.send(program)) {
+            std::cerr << "Lost the connection to " << path << ".\n";
+            return EXIT_FAILURE;
         }
-        else if (std::string(argv[1]) == "-f") {
-            return eval_from_file(argv[2], start);
+    }
+
+    for (std::size_t i = 0; i < programs.size(); i++) {
+        auto response = connection.receive();
+        if (!response) {
+            std::cerr << "Lost the connection to " << path << ".\n";
+            return EXIT_FAILURE;
         }
+        if (response->ok)
+            std::cout << response->text << "\n";
+        else
+            std::cerr << response->text << "\n";
     }
-    else {
-        std::cerr << "Enter a filename to evaluate, or -e <expression>, or use no args for a repl.\n";
-        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+// Programs for --client: -e <expression>, -f <file>, or one per line of stdin.
+bool client_programs(const std::vector<std::string>& args, std::vector<std::string>& programs) {
+    if (args.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty())
+                programs.push_back(line);
+        }
+        return true;
+    }
+    if (args.size() == 2 && args[0] == "-e") {
+        programs.push_back(args[1]);
+        return true;
+    }
+    if (args.size() == 2 && args[0] == "-f") {
+        std::ifstream ifs(args[1]);
+        if (!ifs)
+            return false;
+        programs.emplace_back(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        return true;
+    }
+    return false;
+}
+
+bool take_option(std::vector<std::string>& args, const std::string& name, std::string& value) {
+    auto it = std::find(args.begin(), args.end(), name);
+    if (it == args.end() || it + 1 == args.end())
+        return false;
+
+    value = *(it + 1);
+    args.erase(it, it + 2);
+    return true;
+}
+
+// Reads a non-negative integer option; false if it is present but not a number.
+bool take_number(std::vector<std::string>& args, const std::string& name, std::size_t& number) {
+    std::string value;
+    if (!take_option(args, name, value))
+        return true;
+
+    if (value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit))
+        return false;
+    try {
+        number = std::stoull(value);
+    }
+    catch (std::exception&) {
+        return false;
     }
+    return true;
 }
 
+void usage() {
+    std::cerr << "Enter a filename to evaluate, or -e <expression>, or use no args for a repl.\n";
+    std::cerr << "Options: --threads <n> sets the worker pool size used by pmap.\n";
+    std::cerr << "         --svg <file> writes the graphics objects in the result to an SVG file.\n";
+    std::cerr << "         --serve <socket> evaluates requests from a Unix domain socket;\n";
+    std::cerr << "           --workers <n> sets the number of evaluating threads.\n";
+    std::cerr << "         --fuel <n>, --deadline <ms> and --max-alloc <bytes> limit each\n";
+    std::cerr << "           evaluation's steps, wall-clock time and largest list allocation.\n";
+    std::cerr << "         --max-memory <bytes> stops an evaluation once its interpreter holds more;\n";
+    std::cerr << "           --mem-report prints what each evaluation allocated and kept.\n";
+    std::cerr << "         --profile <file> samples the Plotscript call stack and writes it to\n";
+    std::cerr << "           file as folded stacks, with a per-procedure summary on exit.\n";
+    std::cerr << "         --batch <file> evaluates each top-level form of file as an independent\n";
+    std::cerr << "           job; -j <n> sets the number of jobs run at once.\n";
+    std::cerr << "         --watch <file> evaluates file and then, each time it is saved, only the\n";
+    std::cerr << "           forms that changed and the forms that depend on them.\n";
+    std::cerr << "         --client <socket> sends -e <expression>, -f <file>, or each line\n";
+    std::cerr << "           of standard input to a server.\n";
+}
 
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::size_t threads = std::thread::hardware_concurrency();
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t jobs = workers;
+    std::size_t fuel = 0, deadline = 0, max_alloc = 0, max_memory = 0;
+    if (!take_number(args, "--threads", threads) || !take_number(args, "--workers", workers)
+        || !take_number(args, "-j", jobs) || !take_number(args, "--fuel", fuel)
+        || !take_number(args, "--deadline", deadline) || !take_number(args, "--max-alloc", max_alloc)
+        || !take_number(args, "--max-memory", max_memory)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    Limits limits;
+    limits.fuel = fuel;
+    limits.deadline = std::chrono::milliseconds(deadline);
+    limits.max_alloc = max_alloc;
+    limits.max_memory = max_memory;
 
+    if (auto flag = std::find(args.begin(), args.end(), "--mem-report"); flag != args.end()) {
+        memory_report = true;
+        args.erase(flag);
+    }
+
+    std::string svg_path;
+    take_option(args, "--svg", svg_path);
+
+    if (take_option(args, "--profile", profile_path)) {
+        if (profiler::start())
+            std::atexit(write_profile);
+        else
+            std::cerr << "Profiling is not available on this platform.\n";
+    }
+
+    std::string batch_path;
+    if (take_option(args, "--batch", batch_path)) {
+        if (!args.empty() || jobs == 0) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return run_batch(batch_path, jobs, threads, limits);
+    }
+
+    std::string watch_path;
+    if (take_option(args, "--watch", watch_path)) {
+        if (!args.empty()) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return watch_file(watch_path, threads, limits);
+    }
+
+    std::string socket_path;
+    if (take_option(args, "--serve", socket_path)) {
+        if (!args.empty()) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return serve(socket_path, workers, threads, limits);
+    }
+    if (take_option(args, "--client", socket_path)) {
+        std::vector<std::string> programs;
+        if (!client_programs(args, programs)) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return client(socket_path, programs);
+    }
+
+    Interpreter start(threads);
+    start.set_limits(limits);
+
+    // Ctrl+C stops the evaluation in progress; at the REPL prompt it exits
+    static Interpreter* running = &start;
+    interrupt_evaluation = [] { return running->interrupt(); };
+    install_handler();
+
+    if (args.empty()) {
+        repl(start);
+        return EXIT_SUCCESS;
+    }
+    if (args.size() == 1) {
+        return eval_from_command(args[0], start, svg_path);
+    }
+    else if (args.size() == 2) {
+        if (args[0] == "-e") {
+            return eval_from_command(args[1], start, svg_path);
+        }
+        else if (args[0] == "-f") {
+            return eval_from_file(args[1], start, svg_path);
+        }
+    }
+
+    usage();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,119 @@
+#include "memory.h"
+#include "stats.h"
+
+#include <new>
+
+namespace {
+	thread_local MemoryAccount* current_account = nullptr;
+
+	// Kept in front of every block so deallocate knows whom to credit,
+	// whichever thread frees it. The alignment keeps the block itself aligned
+	// as operator new would have left it.
+	struct alignas(std::max_align_t) Header {
+		MemoryAccount* account;
+		std::size_t size;
+	};
+}
+
+MemoryAccount::MemoryAccount(std::size_t limit) noexcept : cap(limit) {
+}
+
+std::shared_ptr<MemoryAccount> MemoryAccount::open(std::size_t limit) {
+	return std::shared_ptr<MemoryAccount>(new MemoryAccount(limit), [](MemoryAccount* account) {
+		account->release();
+	});
+}
+
+MemoryUsage MemoryAccount::usage() const noexcept {
+	return { held.load(std::memory_order_relaxed), most.load(std::memory_order_relaxed) };
+}
+
+void MemoryAccount::reset_peak() noexcept {
+	most.store(held.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemoryAccount::set_limit(std::size_t bytes) noexcept {
+	cap.store(bytes, std::memory_order_relaxed);
+}
+
+std::size_t MemoryAccount::limit() const noexcept {
+	return cap.load(std::memory_order_relaxed);
+}
+
+bool MemoryAccount::exceeded() const noexcept {
+	std::size_t limit = cap.load(std::memory_order_relaxed);
+	return limit != 0 && held.load(std::memory_order_relaxed) > limit;
+}
+
+bool MemoryAccount::admits(std::size_t bytes) const noexcept {
+	std::size_t limit = cap.load(std::memory_order_relaxed);
+	std::size_t now = held.load(std::memory_order_relaxed);
+	return limit == 0 || (now <= limit && bytes <= limit - now);
+}
+
+void MemoryAccount::charge(std::size_t bytes) noexcept {
+	references.fetch_add(1, std::memory_order_relaxed);
+	std::size_t now = held.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+	std::size_t peak = most.load(std::memory_order_relaxed);
+	while (now > peak && !most.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+	}
+}
+
+void MemoryAccount::credit(std::size_t bytes) noexcept {
+	held.fetch_sub(bytes, std::memory_order_relaxed);
+	release();
+}
+
+void MemoryAccount::release() noexcept {
+	if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
+
+MemoryAccount* MemoryAccount::current() noexcept {
+	return current_account;
+}
+
+MemoryAccount::Scope::Scope(MemoryAccount* account) noexcept : previous(current_account) {
+	current_account = account;
+}
+
+MemoryAccount::Scope::~Scope() {
+	current_account = previous;
+}
+
+namespace memory {
+
+void* allocate(std::size_t bytes) {
+	auto* header = static_cast<Header*>(::operator new(sizeof(Header) + bytes));
+	header->account = current_account;
+	header->size = bytes;
+	stats::add(stats::BytesAllocated, bytes);
+	if (header->account != nullptr)
+		header->account->charge(bytes);
+	return header + 1;
+}
+
+void deallocate(void* block) noexcept {
+	if (block == nullptr)
+		return;
+
+	Header* header = static_cast<Header*>(block) - 1;
+	if (header->account != nullptr)
+		header->account->credit(header->size);
+	::operator delete(header);
+}
+
+Charge::Charge(std::size_t bytes) noexcept : account(current_account), bytes(bytes) {
+	stats::add(stats::BytesAllocated, bytes);
+	if (account != nullptr)
+		account->charge(bytes);
+}
+
+Charge::~Charge() {
+	if (account != nullptr)
+		account->credit(bytes);
+}
+
+}
@@ -0,0 +1,81 @@
+#include "packed.h"
+
+NumericVector::NumericVector(std::vector<double> real)
+	: re(std::move(real)), charge(re.capacity() * sizeof(double)) {
+	for (auto& v : re)
+		v = Atom(v).asNumber();
+}
+
+NumericVector::NumericVector(std::vector<double> real, std::vector<double> imag)
+	: re(std::move(real)), im(std::move(imag)), charge((re.capacity() + im.capacity()) * sizeof(double)) {
+
+	bool complex = false;
+	for (std::size_t i = 0; i < re.size(); i++) {
+		Atom a(std::complex<double>(re[i], im[i]));
+		re[i] = a.asNumber();
+		im[i] = a.asComplex().imag();
+		complex = complex || a.isComplex();
+	}
+
+	if (!complex)
+		im.clear();
+}
+
+std::size_t NumericVector::size() const noexcept {
+	return re.size();
+}
+
+bool NumericVector::isComplex() const noexcept {
+	return !im.empty();
+}
+
+Atom NumericVector::at(std::size_t i) const {
+	if (isComplex() && im[i] != 0)
+		return { std::complex<double>(re[i], im[i]) };
+	return { re[i] };
+}
+
+const std::vector<double>& NumericVector::reals() const noexcept {
+	return re;
+}
+
+const std::vector<double>& NumericVector::imags() const noexcept {
+	return im;
+}
+
+const std::vector<Expression, memory::Allocator<Expression>>& NumericVector::expanded() const {
+	std::call_once(expand_once, [this] {
+		items.reserve(size());
+		for (std::size_t i = 0; i < size(); i++)
+			items.emplace_back(at(i));
+	});
+	return items;
+}
+
+std::shared_ptr<const NumericVector> NumericVector::pack(std::span<const Expression> items) {
+
+	if (items.empty())
+		return nullptr;
+
+	std::vector<double> real, imag;
+	real.reserve(items.size());
+	bool complex = false;
+
+	for (const auto& e : items) {
+		if (!e.isPlainNumber())
+			return nullptr;
+
+		Atom a = e.head();
+		real.push_back(a.asNumber());
+		if (a.isComplex() && !complex) {
+			complex = true;
+			imag.resize(real.size() - 1, 0);
+		}
+		if (complex)
+			imag.push_back(a.asComplex().imag());
+	}
+
+	if (complex)
+		return std::make_shared<const NumericVector>(std::move(real), std::move(imag));
+	return std::make_shared<const NumericVector>(std::move(real));
+}
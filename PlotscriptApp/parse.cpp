@@ -31,6 +31,7 @@ Expression parse(const TokenSequence& tokens) noexcept
             if (stack.empty()) {
                 return {};
             }
+            stack.top()->markEmptyCall();
             stack.pop();
 
             if (stack.empty()) {
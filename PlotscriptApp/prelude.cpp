@@ -0,0 +1,23 @@
+#include "prelude.h"
+
+namespace {
+	Expression build_node(const PreludeNode*& node) {
+		const PreludeNode& current = *node++;
+		Atom head = current.kind == PreludeNode::Number ? Atom(current.number) : Atom(std::string(current.symbol));
+
+		std::vector<Expression> tail;
+		tail.reserve(current.children);
+		for (std::size_t i = 0; i < current.children; i++)
+			tail.push_back(build_node(node));
+		Expression exp(head, std::move(tail));
+		if (current.empty_call)
+			exp.markEmptyCall();
+		return exp;
+	}
+}
+
+Expression build_prelude(const PreludeNode* nodes, std::size_t count) {
+	if (count == 0)
+		return {};
+	return build_node(nodes);
+}
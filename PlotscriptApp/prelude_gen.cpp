@@ -0,0 +1,68 @@
+// Build step: parses startup.script with the interpreter's own tokenizer and
+// parser and writes it out as a pre-order PreludeNode table.
+#include "parse.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+	std::string quoted(const std::string& text) {
+		std::string out = "\"";
+		for (char c : text) {
+			if (c == '"' || c == '\\')
+				out += '\\';
+			out += c;
+		}
+		return out + "\"";
+	}
+
+	void write_node(std::ostream& out, const Expression& exp) {
+		Atom head = exp.head();
+		std::size_t children = exp.tailConstEnd() - exp.tailConstBegin();
+
+		if (head.isNumber()) {
+			char digits[32];
+			auto result = std::to_chars(digits, digits + sizeof(digits), head.asNumber());
+			out << "\t{ PreludeNode::Number, nullptr, " << std::string(digits, result.ptr) << ", " << children << ", false },\n";
+		}
+		else {
+			out << "\t{ PreludeNode::Symbol, " << quoted(head.asSymbol()) << ", 0, " << children << ", "
+				<< (exp.isEmptyCall() ? "true" : "false") << " },\n";
+		}
+
+		for (auto it = exp.tailConstBegin(); it != exp.tailConstEnd(); it++)
+			write_node(out, *it);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		std::cerr << "Usage: prelude_gen <startup.script> <output header>\n";
+		return EXIT_FAILURE;
+	}
+
+	std::ifstream script(argv[1]);
+	if (!script) {
+		std::cerr << "prelude_gen: could not open " << argv[1] << "\n";
+		return EXIT_FAILURE;
+	}
+
+	Expression prelude = parse(tokenize(script));
+	if (prelude == Expression()) {
+		std::cerr << "prelude_gen: " << argv[1] << " is not a valid program\n";
+		return EXIT_FAILURE;
+	}
+
+	std::ofstream out(argv[2]);
+	out << "// Generated by prelude_gen from " << argv[1] << ". Do not edit.\n"
+		<< "#pragma once\n\n"
+		<< "#include \"prelude.h\"\n\n"
+		<< "constexpr PreludeNode PRELUDE[] = {\n";
+	write_node(out, prelude);
+	out << "};\n";
+
+	return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,381 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define PROFILER_TIMER 1
+#include <cerrno>
+#include <csignal>
+#include <sys/time.h>
+#endif
+
+namespace profiler {
+
+namespace {
+	// Frames sampled per thread; a deeper stack is sampled as its outermost
+	// MAX_DEPTH frames.
+	constexpr std::size_t MAX_DEPTH = 256;
+	// Sample buffer per thread, in words: each sample is its depth followed
+	// by that many frame ids.
+	constexpr std::size_t RING = std::size_t(1) << 16;
+
+	std::atomic<bool> running{false};
+	std::atomic<std::uint64_t> taken{0};
+	std::chrono::microseconds period{0};
+	std::clock_t cpu_start = 0;
+	std::clock_t cpu_used = 0;
+
+	std::chrono::microseconds cpu_time(std::clock_t ticks) {
+		return std::chrono::microseconds(static_cast<std::int64_t>(1e6 * static_cast<double>(ticks) / CLOCKS_PER_SEC));
+	}
+
+	// ids are never reused, so a name stays valid however long it is held
+	std::mutex names_lock;
+	std::vector<std::string> names;
+	std::unordered_map<std::string, std::uint32_t> ids;
+
+	std::uint32_t intern(std::string_view name) {
+		std::lock_guard<std::mutex> guard(names_lock);
+		auto [it, added] = ids.try_emplace(std::string(name), static_cast<std::uint32_t>(names.size()));
+		if (added)
+			names.emplace_back(name);
+		return it->second;
+	}
+
+	struct NameHash {
+		using is_transparent = void;
+		std::size_t operator()(std::string_view name) const noexcept {
+			return std::hash<std::string_view>{}(name);
+		}
+	};
+
+	const std::string OUTSIDE = "(outside evaluation)";
+}
+
+// A thread's Plotscript stack and the samples taken of it. The stack and the
+// sample buffer are written from the thread itself and from its signal
+// handler only; collect() reads the rest under lock.
+struct Thread {
+	std::uint32_t frames[MAX_DEPTH];
+	std::atomic<std::size_t> depth{0};
+
+	std::uint32_t ring[RING];
+	// the handler appends at tail; drain() consumes from head
+	std::atomic<std::size_t> head{0};
+	std::atomic<std::size_t> tail{0};
+	std::atomic<std::uint64_t> dropped{0};
+
+	// intern() without the shared lock, for names this thread has seen
+	std::unordered_map<std::string, std::uint32_t, NameHash, std::equal_to<>> known;
+
+	std::mutex lock;
+	std::vector<std::uint64_t> calls;
+	std::map<Stack, std::uint64_t> stacks;
+
+	std::uint32_t id(std::string_view name) {
+		if (auto it = known.find(name); it != known.end())
+			return it->second;
+		std::uint32_t id = intern(name);
+		known.emplace(name, id);
+		return id;
+	}
+
+	void push(std::uint32_t id) noexcept {
+		std::size_t at = depth.load(std::memory_order_relaxed);
+		if (at < MAX_DEPTH)
+			frames[at] = id;
+		// the handler must never see the new depth before the frame
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		depth.store(at + 1, std::memory_order_relaxed);
+	}
+
+	void pop(std::size_t count) noexcept {
+		depth.store(depth.load(std::memory_order_relaxed) - count, std::memory_order_relaxed);
+	}
+
+	// Called from the signal handler.
+	void record() noexcept {
+		std::size_t count = std::min(depth.load(std::memory_order_relaxed), MAX_DEPTH);
+		std::size_t end = tail.load(std::memory_order_relaxed);
+		if (RING - (end - head.load(std::memory_order_acquire)) < count + 1) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		ring[end % RING] = static_cast<std::uint32_t>(count);
+		for (std::size_t i = 0; i < count; i++)
+			ring[(end + 1 + i) % RING] = frames[i];
+		tail.store(end + count + 1, std::memory_order_release);
+	}
+
+	[[nodiscard]] std::size_t pending() const noexcept {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed);
+	}
+
+	// Moves samples from the buffer into stacks; the caller holds lock.
+	void drain() {
+		std::size_t end = tail.load(std::memory_order_acquire);
+		std::size_t at = head.load(std::memory_order_relaxed);
+
+		Stack stack;
+		while (at != end) {
+			std::size_t count = ring[at % RING];
+			stack.clear();
+			for (std::size_t i = 0; i < count; i++)
+				stack.push_back(ring[(at + 1 + i) % RING]);
+			stacks[stack]++;
+			at += count + 1;
+		}
+		head.store(at, std::memory_order_release);
+	}
+};
+
+namespace {
+	std::mutex threads_lock;
+	// never freed: a thread's pointer to its own stays valid after a session ends
+	std::vector<std::unique_ptr<Thread>> threads;
+
+	thread_local Thread* current = nullptr;
+
+	Thread* this_thread() {
+		if (current == nullptr) {
+			std::lock_guard<std::mutex> guard(threads_lock);
+			threads.push_back(std::make_unique<Thread>());
+			current = threads.back().get();
+		}
+		return current;
+	}
+
+#ifdef PROFILER_TIMER
+	void take_sample(int) {
+		int saved = errno;
+		taken.fetch_add(1, std::memory_order_relaxed);
+		if (current != nullptr)
+			current->record();
+		errno = saved;
+	}
+
+	bool set_timer(std::chrono::microseconds interval) {
+		itimerval timer{};
+		timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000);
+		timer.it_interval.tv_usec = static_cast<suseconds_t>(interval.count() % 1000000);
+		timer.it_value = timer.it_interval;
+		return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+	}
+#endif
+}
+
+bool start(std::chrono::microseconds interval) {
+#ifdef PROFILER_TIMER
+	{
+		std::lock_guard<std::mutex> guard(threads_lock);
+		for (auto& thread : threads) {
+			std::lock_guard<std::mutex> own(thread->lock);
+			thread->drain();
+			thread->stacks.clear();
+			thread->calls.clear();
+			thread->dropped.store(0);
+		}
+	}
+	taken.store(0);
+	period = std::max(interval, std::chrono::microseconds(1));
+	cpu_start = std::clock();
+	cpu_used = 0;
+
+	// left installed after stop(), so a signal already on its way is harmless
+	struct sigaction action {};
+	action.sa_handler = take_sample;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	if (sigaction(SIGPROF, &action, nullptr) != 0)
+		return false;
+
+	running.store(true);
+	if (!set_timer(period)) {
+		running.store(false);
+		return false;
+	}
+	return true;
+#else
+	(void)interval;
+	return false;
+#endif
+}
+
+void stop() {
+#ifdef PROFILER_TIMER
+	set_timer(std::chrono::microseconds(0));
+#endif
+	if (running.exchange(false))
+		cpu_used = std::clock() - cpu_start;
+}
+
+bool active() noexcept {
+	return running.load(std::memory_order_relaxed);
+}
+
+Profile collect() {
+	std::map<Stack, std::uint64_t> stacks;
+	std::vector<std::uint64_t> calls;
+	Profile profile;
+	{
+		std::lock_guard<std::mutex> guard(threads_lock);
+		for (auto& thread : threads) {
+			std::lock_guard<std::mutex> own(thread->lock);
+			thread->drain();
+			for (const auto& [stack, count] : thread->stacks)
+				stacks[stack] += count;
+			calls.resize(std::max(calls.size(), thread->calls.size()));
+			for (std::size_t id = 0; id < thread->calls.size(); id++)
+				calls[id] += thread->calls[id];
+			profile.dropped += thread->dropped.load();
+		}
+	}
+
+	profile.interval = period;
+	profile.cpu = cpu_time(cpu_used);
+	profile.samples = taken.load();
+
+	// samples of threads that never evaluated anything, such as the server's I/O
+	std::uint64_t recorded = profile.dropped;
+	for (const auto& entry : stacks)
+		recorded += entry.second;
+	if (profile.samples > recorded)
+		stacks[{}] += profile.samples - recorded;
+
+	std::vector<std::string> known;
+	{
+		std::lock_guard<std::mutex> guard(names_lock);
+		known = names;
+	}
+
+	std::vector<Procedure> procedures(known.size());
+	for (std::size_t id = 0; id < known.size(); id++) {
+		procedures[id].name = known[id];
+		procedures[id].calls = id < calls.size() ? calls[id] : 0;
+	}
+
+	Stack seen;
+	for (const auto& [stack, count] : stacks) {
+		std::string line;
+		for (std::uint32_t id : stack) {
+			if (!line.empty())
+				line += ';';
+			line += known[id];
+		}
+		profile.folded.emplace_back(line.empty() ? OUTSIDE : line, count);
+
+		if (stack.empty())
+			continue;
+		// a recursive procedure counts once per sample
+		seen = stack;
+		std::sort(seen.begin(), seen.end());
+		seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+		for (std::uint32_t id : seen)
+			procedures[id].inclusive += count;
+		procedures[stack.back()].exclusive += count;
+	}
+
+	for (auto& procedure : procedures) {
+		if (procedure.calls != 0 || procedure.inclusive != 0)
+			profile.procedures.push_back(std::move(procedure));
+	}
+	std::sort(profile.procedures.begin(), profile.procedures.end(), [](const Procedure& a, const Procedure& b) {
+		return a.exclusive != b.exclusive ? a.exclusive > b.exclusive : a.inclusive > b.inclusive;
+	});
+
+	return profile;
+}
+
+void write_folded(std::ostream& out, const Profile& profile) {
+	for (const auto& [stack, count] : profile.folded)
+		out << stack << " " << count << "\n";
+}
+
+void write_summary(std::ostream& out, const Profile& profile) {
+	// what one sample stands for: the timer fires at its own resolution, often
+	// coarser than the interval asked for
+	double ms = profile.samples == 0 ? 0.0
+		: static_cast<double>(profile.cpu.count()) / 1000 / static_cast<double>(profile.samples);
+
+	out << std::left << std::setw(24) << "procedure" << std::right << std::setw(12) << "calls"
+		<< std::setw(16) << "inclusive ms" << std::setw(16) << "exclusive ms" << "\n";
+	for (const auto& p : profile.procedures) {
+		out << std::left << std::setw(24) << p.name << std::right << std::setw(12) << p.calls
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(16) << static_cast<double>(p.inclusive) * ms
+			<< std::setw(16) << static_cast<double>(p.exclusive) * ms << "\n";
+	}
+	out << profile.samples << " samples over " << profile.cpu.count() / 1000 << " ms of CPU time";
+	if (profile.dropped != 0)
+		out << ", " << profile.dropped << " dropped";
+	out << "\n";
+}
+
+Frame::Frame(std::string_view name) {
+	if (active())
+		push(name);
+}
+
+Frame::Frame(const Atom& name) {
+	if (active())
+		push(name.asSymbol());
+}
+
+void Frame::push(std::string_view name) {
+	thread = this_thread();
+	std::uint32_t id = thread->id(name);
+	{
+		std::lock_guard<std::mutex> guard(thread->lock);
+		if (thread->calls.size() <= id)
+			thread->calls.resize(id + 1);
+		thread->calls[id]++;
+		if (thread->pending() > RING / 2)
+			thread->drain();
+	}
+	thread->push(id);
+}
+
+Frame::~Frame() {
+	if (thread != nullptr)
+		thread->pop(1);
+}
+
+Stack capture() {
+	if (!active() || current == nullptr)
+		return {};
+
+	std::size_t count = std::min(current->depth.load(std::memory_order_relaxed), MAX_DEPTH);
+	return Stack(current->frames, current->frames + count);
+}
+
+Adopt::Adopt(const Stack& stack) {
+	if (stack.empty())
+		return;
+
+	Thread* own = this_thread();
+	// a thread running part of its own work already has these frames
+	if (own->depth.load(std::memory_order_relaxed) != 0)
+		return;
+
+	thread = own;
+	count = stack.size();
+	for (std::uint32_t id : stack)
+		thread->push(id);
+}
+
+Adopt::~Adopt() {
+	if (thread != nullptr)
+		thread->pop(count);
+}
+
+}
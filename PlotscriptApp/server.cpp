@@ -0,0 +1,559 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace wire {
+
+void append_message(std::string& out, std::string_view payload) {
+	auto length = static_cast<std::uint32_t>(payload.size());
+	char prefix[4] = {
+		static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+		static_cast<char>(length >> 8), static_cast<char>(length)
+	};
+	out.append(prefix, 4);
+	out.append(payload);
+}
+
+Take take_message(const std::string& buffer, std::size_t& offset, std::string& payload) {
+	if (buffer.size() - offset < 4)
+		return Take::Incomplete;
+
+	auto byte = [&](std::size_t i) { return static_cast<std::uint32_t>(static_cast<unsigned char>(buffer[offset + i])); };
+	std::size_t length = (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3);
+	if (length > MAX_MESSAGE)
+		return Take::TooLong;
+	if (buffer.size() - offset - 4 < length)
+		return Take::Incomplete;
+
+	payload.assign(buffer, offset + 4, length);
+	offset += 4 + length;
+	return Take::Message;
+}
+
+}
+
+namespace {
+
+	// Requests read from one connection but not yet answered, and bytes of
+	// response not yet sent to it; past either the server stops reading from
+	// it until responses drain.
+	constexpr std::uint64_t MAX_IN_FLIGHT = 1024;
+	constexpr std::size_t MAX_UNSENT = std::size_t(4) << 20;
+
+	constexpr std::size_t READ_SIZE = 64 * 1024;
+
+	// epoll data for the two descriptors that are not clients
+	constexpr std::uint64_t LISTENER = 0;
+	constexpr std::uint64_t WAKE = 1;
+
+	std::string respond(wire::Status status, const std::string& text) {
+		std::string response(1, static_cast<char>(status));
+		response += text;
+		return response;
+	}
+
+	std::string evaluate(Interpreter& interp, const std::string& program) {
+		Result result = interp.run_isolated(program);
+		if (!result)
+			return respond(wire::Status::Error, result.error().message());
+
+		std::ostringstream out;
+		out << *result;
+		return respond(wire::Status::Ok, out.str());
+	}
+}
+
+bool Server::Connection::saturated() const noexcept {
+	std::size_t unsent = output.size() - output_offset + finished_bytes;
+	return next_request - next_response >= MAX_IN_FLIGHT || unsent >= MAX_UNSENT;
+}
+
+#ifdef __linux__
+
+namespace {
+
+	bool socket_address(const std::string& path, sockaddr_un& address) {
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			return false;
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+
+	int connect_to(const std::string& path) {
+		sockaddr_un address;
+		if (!socket_address(path, address))
+			return -1;
+
+		int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return -1;
+		if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	std::string system_error(const std::string& what) {
+		return "Error: " + what + ": " + std::strerror(errno);
+	}
+}
+
+Client::Client(const std::string& path) : fd(connect_to(path)) {
+}
+
+Client::~Client() {
+	if (fd >= 0)
+		::close(fd);
+}
+
+bool Client::is_open() const noexcept {
+	return fd >= 0;
+}
+
+bool Client::send(std::string_view program) {
+	std::string message;
+	wire::append_message(message, program);
+
+	std::size_t sent = 0;
+	while (fd >= 0 && sent < message.size()) {
+		ssize_t n = ::send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		sent += static_cast<std::size_t>(n);
+	}
+	return fd >= 0;
+}
+
+std::optional<Client::Response> Client::receive() {
+	std::string payload;
+	while (fd >= 0) {
+		wire::Take taken = wire::take_message(buffer, offset, payload);
+		if (taken == wire::Take::TooLong)
+			return std::nullopt;
+
+		if (taken == wire::Take::Message) {
+			if (offset == buffer.size()) {
+				buffer.clear();
+				offset = 0;
+			}
+			if (payload.empty())
+				return std::nullopt;
+			return Response{ payload[0] == static_cast<char>(wire::Status::Ok), payload.substr(1) };
+		}
+
+		char chunk[READ_SIZE];
+		ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return std::nullopt;
+		buffer.append(chunk, static_cast<std::size_t>(n));
+	}
+	return std::nullopt;
+}
+
+Server::Server(std::string path, std::size_t workers, std::size_t threads, const Limits& limits)
+	: path(std::move(path)), base(threads), worker_count(std::max<std::size_t>(workers, 1)), next_client(WAKE + 1) {
+
+	base.set_limits(limits);
+	wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+Server::~Server() {
+	shut_down();
+	if (wake_fd >= 0)
+		::close(wake_fd);
+}
+
+void Server::stop() noexcept {
+	stopping = true;
+	if (wake_fd >= 0) {
+		std::uint64_t one = 1;
+		[[maybe_unused]] ssize_t n = ::write(wake_fd, &one, sizeof(one));
+	}
+}
+
+std::optional<Error> Server::listen() {
+	sockaddr_un address;
+	if (!socket_address(path, address))
+		return Error("Error: socket path is too long: " + path);
+
+	// a socket file nobody answers on is left over from an earlier server
+	struct stat info {};
+	if (::stat(path.c_str(), &info) == 0) {
+		if (!S_ISSOCK(info.st_mode))
+			return Error("Error: " + path + " exists and is not a socket");
+		int live = connect_to(path);
+		if (live >= 0) {
+			::close(live);
+			return Error("Error: a server is already listening on " + path);
+		}
+		::unlink(path.c_str());
+	}
+
+	listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+		return Error(system_error("socket"));
+	if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		return Error(system_error("could not bind " + path));
+	if (::listen(listen_fd, SOMAXCONN) != 0)
+		return Error(system_error("listen"));
+
+	epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0 || wake_fd < 0)
+		return Error(system_error("epoll"));
+
+	epoll_event event {};
+	event.events = EPOLLIN;
+	event.data.u64 = LISTENER;
+	::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+	event.data.u64 = WAKE;
+	::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+	return std::nullopt;
+}
+
+std::optional<Error> Server::run() {
+	if (auto error = listen()) {
+		shut_down();
+		return error;
+	}
+
+	// forked one at a time: fork() moves base's own bindings into a shared layer
+	for (std::size_t i = 0; i < worker_count; i++)
+		workers.emplace_back(&Server::work, this, base.fork());
+
+	std::vector<epoll_event> events(64);
+	while (!stopping) {
+		int count = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0) {
+			Error error(system_error("epoll_wait"));
+			shut_down();
+			return error;
+		}
+
+		for (int i = 0; i < count; i++) {
+			std::uint64_t id = events[i].data.u64;
+			std::uint32_t ready = events[i].events;
+
+			if (id == LISTENER) {
+				accept_clients();
+			}
+			else if (id == WAKE) {
+				std::uint64_t value;
+				[[maybe_unused]] ssize_t n = ::read(wake_fd, &value, sizeof(value));
+				collect();
+			}
+			else if (ready & (EPOLLHUP | EPOLLERR)) {
+				// the client is gone in both directions, nothing can be answered
+				close_client(id);
+			}
+			else {
+				if (ready & EPOLLIN)
+					read_client(id);
+				if (ready & EPOLLOUT)
+					write_client(id);
+			}
+		}
+	}
+
+	shut_down();
+	return std::nullopt;
+}
+
+void Server::work(Interpreter interp) {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> guard(job_lock);
+			job_ready.wait(guard, [&] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		Done finished{ job.client, job.sequence, evaluate(interp, job.program) };
+		{
+			std::lock_guard<std::mutex> guard(done_lock);
+			done.push_back(std::move(finished));
+		}
+		std::uint64_t one = 1;
+		[[maybe_unused]] ssize_t n = ::write(wake_fd, &one, sizeof(one));
+	}
+}
+
+void Server::accept_clients() {
+	while (true) {
+		int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		std::uint64_t id = next_client++;
+		clients[id].fd = fd;
+
+		epoll_event event {};
+		event.events = EPOLLIN;
+		event.data.u64 = id;
+		::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+		clients[id].events = EPOLLIN;
+	}
+}
+
+void Server::read_client(std::uint64_t id) {
+	auto it = clients.find(id);
+	if (it == clients.end())
+		return;
+	Connection& client = it->second;
+
+	char chunk[READ_SIZE];
+	while (true) {
+		ssize_t n = ::recv(client.fd, chunk, sizeof(chunk), 0);
+		if (n > 0) {
+			client.input.append(chunk, static_cast<std::size_t>(n));
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		// end of input or a failed connection
+		if (n < 0) {
+			close_client(id);
+			return;
+		}
+		client.draining = true;
+		break;
+	}
+
+	queue_requests(id);
+}
+
+void Server::queue_requests(std::uint64_t id) {
+	auto it = clients.find(id);
+	if (it == clients.end())
+		return;
+	Connection& client = it->second;
+
+	std::vector<Job> batch;
+	std::string program;
+	while (!client.saturated()) {
+		wire::Take taken = wire::take_message(client.input, client.input_offset, program);
+		if (taken == wire::Take::TooLong) {
+			close_client(id);
+			return;
+		}
+		if (taken == wire::Take::Incomplete)
+			break;
+		batch.push_back({ id, client.next_request++, std::move(program) });
+	}
+
+	if (client.input_offset == client.input.size()) {
+		client.input.clear();
+		client.input_offset = 0;
+	}
+	else if (client.input_offset > READ_SIZE) {
+		client.input.erase(0, client.input_offset);
+		client.input_offset = 0;
+	}
+
+	if (!batch.empty()) {
+		{
+			std::lock_guard<std::mutex> guard(job_lock);
+			for (auto& job : batch)
+				jobs.push_back(std::move(job));
+		}
+		if (batch.size() == 1)
+			job_ready.notify_one();
+		else
+			job_ready.notify_all();
+	}
+
+	update_events(id);
+}
+
+void Server::collect() {
+	std::vector<Done> finished;
+	{
+		std::lock_guard<std::mutex> guard(done_lock);
+		finished.swap(done);
+	}
+
+	std::vector<std::uint64_t> touched;
+	for (auto& result : finished) {
+		auto it = clients.find(result.client);
+		if (it == clients.end())
+			continue;
+		it->second.finished_bytes += result.response.size();
+		it->second.finished.emplace(result.sequence, std::move(result.response));
+		touched.push_back(result.client);
+	}
+
+	for (std::uint64_t id : touched) {
+		auto it = clients.find(id);
+		if (it == clients.end())
+			continue;
+		Connection& client = it->second;
+
+		// release responses in request order
+		for (auto next = client.finished.begin();
+			next != client.finished.end() && next->first == client.next_response;
+			next = client.finished.erase(next)) {
+			wire::append_message(client.output, next->second);
+			client.finished_bytes -= next->second.size();
+			client.next_response++;
+		}
+		write_client(id);
+	}
+}
+
+void Server::write_client(std::uint64_t id) {
+	auto it = clients.find(id);
+	if (it == clients.end())
+		return;
+	Connection& client = it->second;
+
+	while (client.output_offset < client.output.size()) {
+		ssize_t n = ::send(client.fd, client.output.data() + client.output_offset,
+			client.output.size() - client.output_offset, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0) {
+			close_client(id);
+			return;
+		}
+		client.output_offset += static_cast<std::size_t>(n);
+	}
+
+	if (client.output_offset == client.output.size()) {
+		client.output.clear();
+		client.output_offset = 0;
+	}
+
+	// a saturated connection may have requests waiting now that some of its
+	// responses have been answered or sent
+	queue_requests(id);
+}
+
+void Server::update_events(std::uint64_t id) {
+	auto it = clients.find(id);
+	if (it == clients.end())
+		return;
+	Connection& client = it->second;
+
+	bool answered = client.next_request == client.next_response;
+	if (client.draining && answered && client.output.empty()) {
+		close_client(id);
+		return;
+	}
+
+	std::uint32_t wanted = 0;
+	if (!client.draining && !client.saturated())
+		wanted |= EPOLLIN;
+	if (!client.output.empty())
+		wanted |= EPOLLOUT;
+
+	if (wanted != client.events) {
+		epoll_event event {};
+		event.events = wanted;
+		event.data.u64 = id;
+		::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client.fd, &event);
+		client.events = wanted;
+	}
+}
+
+void Server::close_client(std::uint64_t id) {
+	auto it = clients.find(id);
+	if (it == clients.end())
+		return;
+
+	::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+	::close(it->second.fd);
+	// responses still being evaluated for it are dropped in collect()
+	clients.erase(it);
+}
+
+void Server::shut_down() {
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> guard(job_lock);
+		jobs.clear();
+	}
+	job_ready.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+
+	while (!clients.empty())
+		close_client(clients.begin()->first);
+
+	if (listen_fd >= 0) {
+		::close(listen_fd);
+		::unlink(path.c_str());
+		listen_fd = -1;
+	}
+	if (epoll_fd >= 0) {
+		::close(epoll_fd);
+		epoll_fd = -1;
+	}
+}
+
+#else
+
+Client::Client(const std::string&) {
+}
+
+Client::~Client() = default;
+
+bool Client::is_open() const noexcept {
+	return false;
+}
+
+bool Client::send(std::string_view) {
+	return false;
+}
+
+std::optional<Client::Response> Client::receive() {
+	return std::nullopt;
+}
+
+Server::Server(std::string path, std::size_t workers, std::size_t threads, const Limits& limits)
+	: path(std::move(path)), base(threads), worker_count(workers), next_client(WAKE + 1) {
+
+	base.set_limits(limits);
+}
+
+Server::~Server() = default;
+
+void Server::stop() noexcept {
+	stopping = true;
+}
+
+std::optional<Error> Server::run() {
+	(void) evaluate;
+	return Error("Error: --serve needs epoll and is only available on Linux");
+}
+
+#endif
@@ -0,0 +1,265 @@
+#include "spatial.h"
+#include "graphics.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+
+namespace {
+
+	// Below this many objects a serial build is faster than waking the pool.
+	constexpr std::size_t PARALLEL_THRESHOLD = 4096;
+
+	template <typename F>
+	void for_each_index(std::size_t count, F&& body) {
+		ThreadPool* pool = ThreadPool::current();
+		if (pool != nullptr && count >= PARALLEL_THRESHOLD / SpatialIndex::FANOUT) {
+			pool->parallel_for(count, body);
+		}
+		else {
+			for (std::size_t i = 0; i < count; i++)
+				body(i);
+		}
+	}
+
+	// Sorts chunks on the pool, then merges neighbouring runs pairwise.
+	template <typename Less>
+	void parallel_sort(std::vector<std::size_t>& items, Less less) {
+		ThreadPool* pool = ThreadPool::current();
+		std::size_t n = items.size();
+		std::size_t chunks = pool != nullptr ? pool->size() + 1 : 1;
+		if (chunks < 2 || n < PARALLEL_THRESHOLD) {
+			std::sort(items.begin(), items.end(), less);
+			return;
+		}
+
+		auto at = [&](std::size_t i) { return items.begin() + static_cast<std::ptrdiff_t>(std::min(i, n)); };
+		std::size_t width = (n + chunks - 1) / chunks;
+		pool->parallel_for(chunks, [&](std::size_t i) {
+			std::sort(at(i * width), at((i + 1) * width), less);
+		});
+
+		for (; width < n; width *= 2) {
+			pool->parallel_for((n + 2 * width - 1) / (2 * width), [&](std::size_t i) {
+				std::size_t begin = i * 2 * width;
+				std::inplace_merge(at(begin), at(begin + width), at(begin + 2 * width), less);
+			});
+		}
+	}
+
+	bool overlaps(const SpatialIndex::Box& a, const SpatialIndex::Box& b) {
+		return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+	}
+
+	double box_distance2(const SpatialIndex::Box& box, double x, double y) {
+		double dx = std::max({ box.x0 - x, 0.0, x - box.x1 });
+		double dy = std::max({ box.y0 - y, 0.0, y - box.y1 });
+		return dx * dx + dy * dy;
+	}
+}
+
+Expected<std::shared_ptr<const SpatialIndex>> SpatialIndex::build(const Expression& objects) {
+
+	if (objects.head().toString() != "list" || objects.packed())
+		return Error("Error: argument to spatial-index was not a list of points and lines");
+
+	auto index = std::make_shared<SpatialIndex>();
+	index->objects.assign(objects.tailConstBegin(), objects.tailConstEnd());
+	std::size_t n = index->objects.size();
+
+	index->segments.resize(n);
+	std::vector<char> valid(n, 0);
+	for_each_index(n, [&](std::size_t i) {
+		const Expression& obj = index->objects[i];
+		Segment& s = index->segments[i];
+		std::string name = object_name(obj);
+
+		if (name == "point" && point_coordinates(obj, s.x0, s.y0)) {
+			s.x1 = s.x0;
+			s.y1 = s.y0;
+			valid[i] = 1;
+		}
+		else if (name == "line" && obj.tailConstEnd() - obj.tailConstBegin() == 2) {
+			valid[i] = point_coordinates(*obj.tailConstBegin(), s.x0, s.y0)
+				&& point_coordinates(*(obj.tailConstBegin() + 1), s.x1, s.y1);
+		}
+	});
+	if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+		return Error("Error: spatial-index was given an object that is not a point or line");
+
+	// Sort-Tile-Recursive: cut the centres into vertical slices of whole leaves,
+	// then order each slice by y so neighbouring entries share a leaf.
+	auto& order = index->order;
+	const auto& segments = index->segments;
+	order.resize(n);
+	std::iota(order.begin(), order.end(), 0);
+
+	auto by_x = [&](std::size_t a, std::size_t b) {
+		double ca = segments[a].x0 + segments[a].x1, cb = segments[b].x0 + segments[b].x1;
+		return ca < cb || (ca == cb && a < b);
+	};
+	auto by_y = [&](std::size_t a, std::size_t b) {
+		double ca = segments[a].y0 + segments[a].y1, cb = segments[b].y0 + segments[b].y1;
+		return ca < cb || (ca == cb && a < b);
+	};
+	parallel_sort(order, by_x);
+
+	std::size_t leaves = (n + FANOUT - 1) / FANOUT;
+	std::size_t slices = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(leaves))));
+	std::size_t slice = std::max<std::size_t>(1, (leaves + slices - 1) / std::max<std::size_t>(1, slices)) * FANOUT;
+	for_each_index((n + slice - 1) / slice, [&](std::size_t i) {
+		auto begin = order.begin() + static_cast<std::ptrdiff_t>(i * slice);
+		std::sort(begin, order.begin() + static_cast<std::ptrdiff_t>(std::min(n, (i + 1) * slice)), by_y);
+	});
+
+	auto& levels = index->levels;
+	levels.emplace_back(n);
+	for_each_index(n, [&](std::size_t i) {
+		const Segment& s = segments[order[i]];
+		levels[0][i] = { std::min(s.x0, s.x1), std::min(s.y0, s.y1), std::max(s.x0, s.x1), std::max(s.y0, s.y1) };
+	});
+
+	while (levels.back().size() > 1) {
+		const std::vector<Box>& below = levels.back();
+		std::vector<Box> level((below.size() + FANOUT - 1) / FANOUT);
+		for_each_index(level.size(), [&](std::size_t i) {
+			std::size_t end = std::min(below.size(), (i + 1) * FANOUT);
+			Box box = below[i * FANOUT];
+			for (std::size_t child = i * FANOUT + 1; child < end; child++) {
+				box.x0 = std::min(box.x0, below[child].x0);
+				box.y0 = std::min(box.y0, below[child].y0);
+				box.x1 = std::max(box.x1, below[child].x1);
+				box.y1 = std::max(box.y1, below[child].y1);
+			}
+			level[i] = box;
+		});
+		levels.push_back(std::move(level));
+	}
+
+	return std::shared_ptr<const SpatialIndex>(std::move(index));
+}
+
+bool SpatialIndex::touches(const Segment& s, const Box& rect) {
+	// Liang-Barsky: clip the segment's parameter range against each edge
+	double t0 = 0, t1 = 1;
+	auto clip = [&](double p, double q) {
+		if (p == 0)
+			return q >= 0;
+		double t = q / p;
+		if (p < 0) {
+			if (t > t1)
+				return false;
+			t0 = std::max(t0, t);
+		}
+		else {
+			if (t < t0)
+				return false;
+			t1 = std::min(t1, t);
+		}
+		return true;
+	};
+
+	double dx = s.x1 - s.x0, dy = s.y1 - s.y0;
+	return clip(-dx, s.x0 - rect.x0) && clip(dx, rect.x1 - s.x0)
+		&& clip(-dy, s.y0 - rect.y0) && clip(dy, rect.y1 - s.y0);
+}
+
+double SpatialIndex::distance2(const Segment& s, double x, double y) {
+	double dx = s.x1 - s.x0, dy = s.y1 - s.y0;
+	double length2 = dx * dx + dy * dy;
+	double t = length2 > 0 ? std::clamp(((x - s.x0) * dx + (y - s.y0) * dy) / length2, 0.0, 1.0) : 0;
+
+	double ex = s.x0 + t * dx - x, ey = s.y0 + t * dy - y;
+	return ex * ex + ey * ey;
+}
+
+std::vector<Expression> SpatialIndex::query(const Box& rect) const {
+
+	std::vector<std::size_t> hits;
+	std::vector<std::pair<std::size_t, std::size_t>> pending;
+	if (!levels[0].empty())
+		pending.emplace_back(levels.size() - 1, 0);
+
+	while (!pending.empty()) {
+		auto [level, node] = pending.back();
+		pending.pop_back();
+
+		if (!overlaps(levels[level][node], rect))
+			continue;
+		if (level == 0) {
+			if (touches(segments[order[node]], rect))
+				hits.push_back(order[node]);
+			continue;
+		}
+
+		std::size_t end = std::min(levels[level - 1].size(), (node + 1) * FANOUT);
+		for (std::size_t child = node * FANOUT; child < end; child++)
+			pending.emplace_back(level - 1, child);
+	}
+
+	std::sort(hits.begin(), hits.end());
+	std::vector<Expression> result;
+	result.reserve(hits.size());
+	for (std::size_t i : hits)
+		result.push_back(objects[i]);
+	return result;
+}
+
+std::vector<Expression> SpatialIndex::nearest(double x, double y, std::size_t k) const {
+
+	// best-first search: leaf entries carry their exact distance, nodes the
+	// distance to their box, so an entry comes off the queue only once nothing
+	// unexplored can be closer
+	struct Candidate {
+		double distance2;
+		std::size_t level;
+		std::size_t node;
+
+		bool operator>(const Candidate& other) const {
+			if (distance2 != other.distance2)
+				return distance2 > other.distance2;
+			if (level != other.level)
+				return level > other.level;
+			return node > other.node;
+		}
+	};
+
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> queue;
+	auto push = [&](std::size_t level, std::size_t node) {
+		double d = level == 0 ? distance2(segments[order[node]], x, y) : box_distance2(levels[level][node], x, y);
+		queue.push({ d, level, node });
+	};
+
+	if (!levels[0].empty())
+		push(levels.size() - 1, 0);
+
+	std::vector<Expression> result;
+	while (!queue.empty() && result.size() < k) {
+		Candidate next = queue.top();
+		queue.pop();
+
+		if (next.level == 0) {
+			result.push_back(objects[order[next.node]]);
+			continue;
+		}
+
+		std::size_t end = std::min(levels[next.level - 1].size(), (next.node + 1) * FANOUT);
+		for (std::size_t child = next.node * FANOUT; child < end; child++)
+			push(next.level - 1, child);
+	}
+	return result;
+}
+
+std::size_t SpatialIndex::size() const noexcept {
+	return objects.size();
+}
+
+std::string SpatialIndex::name() const {
+	return "spatial-index";
+}
+
+std::string SpatialIndex::describe() const {
+	return "spatial-index of " + std::to_string(objects.size()) + " objects";
+}
@@ -0,0 +1,73 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace stats {
+
+namespace {
+	struct Block {
+		std::array<std::atomic<std::uint64_t>, COUNT> values{};
+		Block* next = nullptr;
+	};
+
+	// Blocks are never freed, so read() can walk them while threads come and
+	// go; a thread's counts outlive it.
+	std::atomic<Block*> blocks{nullptr};
+
+	thread_local Block* mine = nullptr;
+
+	// Counting happens inside memory::allocate, so the block comes from malloc
+	// and joins the list without a lock.
+	Block& local() noexcept {
+		if (mine == nullptr) {
+			void* storage = std::malloc(sizeof(Block));
+			if (storage == nullptr)
+				std::abort();
+			Block* block = new (storage) Block();
+			block->next = blocks.load(std::memory_order_relaxed);
+			while (!blocks.compare_exchange_weak(block->next, block, std::memory_order_release,
+				std::memory_order_relaxed)) {
+			}
+			mine = block;
+		}
+		return *mine;
+	}
+
+	bool is_maximum(Counter counter) noexcept {
+		return counter == LongestTail;
+	}
+}
+
+void add(Counter counter, std::uint64_t n) noexcept {
+	local().values[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void raise(Counter counter, std::uint64_t value) noexcept {
+	auto& slot = local().values[counter];
+	if (slot.load(std::memory_order_relaxed) < value)
+		slot.store(value, std::memory_order_relaxed);
+}
+
+Snapshot read() noexcept {
+	Snapshot snapshot;
+	for (Block* block = blocks.load(std::memory_order_acquire); block != nullptr; block = block->next) {
+		for (std::size_t i = 0; i < COUNT; i++) {
+			std::uint64_t value = block->values[i].load(std::memory_order_relaxed);
+			auto counter = static_cast<Counter>(i);
+			snapshot.values[i] = is_maximum(counter) ? std::max(snapshot.values[i], value) : snapshot.values[i] + value;
+		}
+	}
+	return snapshot;
+}
+
+void reset() noexcept {
+	for (Block* block = blocks.load(std::memory_order_acquire); block != nullptr; block = block->next) {
+		for (auto& value : block->values)
+			value.store(0, std::memory_order_relaxed);
+	}
+}
+
+}
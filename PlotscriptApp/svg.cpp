@@ -0,0 +1,162 @@
+#include "svg.h"
+#include "graphics.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace {
+	const std::string SIZE = "\"size\"";
+	const std::string THICKNESS = "\"thickness\"";
+	const std::string POSITION = "\"position\"";
+	const std::string TEXT_SCALE = "\"text-scale\"";
+	const std::string TEXT_ROTATION = "\"text-rotation\"";
+
+	double number_property(const Expression& obj, const std::string& key, double fallback) {
+		const Expression* value = obj.findProperty(key);
+		return value && value->head().isNumber() ? value->head().asNumber() : fallback;
+	}
+}
+
+void SvgWriter::Bounds::add(double x, double y) {
+	if (empty) {
+		left = right = x;
+		top = bottom = y;
+		empty = false;
+		return;
+	}
+	left = std::min(left, x);
+	right = std::max(right, x);
+	top = std::min(top, y);
+	bottom = std::max(bottom, y);
+}
+
+SvgWriter::SvgWriter(const std::string& path) : path(path), buffer(1 << 20) {
+	out = std::fopen(path.c_str(), "wb");
+	if (out)
+		std::setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+}
+
+SvgWriter::~SvgWriter() {
+	if (out)
+		std::fclose(out);
+}
+
+bool SvgWriter::is_open() const noexcept {
+	return out != nullptr;
+}
+
+void SvgWriter::put(const char* text) {
+	std::fputs(text, out);
+}
+
+void SvgWriter::put(double value) {
+	if (value == 0)
+		value = 0; // negated zero coordinates would print as -0
+	char digits[32];
+	auto result = std::to_chars(digits, digits + sizeof(digits), value);
+	std::fwrite(digits, 1, result.ptr - digits, out);
+}
+
+void SvgWriter::put_text(const std::string& text) {
+	for (char c : text) {
+		switch (c) {
+			case '"': break;
+			case '<': put("&lt;"); break;
+			case '>': put("&gt;"); break;
+			case '&': put("&amp;"); break;
+			default: std::fputc(c, out);
+		}
+	}
+}
+
+// SVG y grows downward, plot y grows upward, so every y is written negated.
+void SvgWriter::measure(const Expression& obj, Bounds& bounds) const {
+	std::string name = object_name(obj);
+	double x, y;
+
+	if (name == "point" && point_coordinates(obj, x, y)) {
+		bounds.add(x, -y);
+	}
+	else if (name == "line" || (name.empty() && !obj.packed())) {
+		for (auto it = obj.tailConstBegin(); it != obj.tailConstEnd(); it++)
+			measure(*it, bounds);
+	}
+	else if (name == "text") {
+		const Expression* position = obj.findProperty(POSITION);
+		if (position && point_coordinates(*position, x, y))
+			bounds.add(x, -y);
+	}
+}
+
+void SvgWriter::emit(const Expression& obj) {
+	std::string name = object_name(obj);
+	double x, y;
+
+	if (name == "point" && point_coordinates(obj, x, y)) {
+		put("<circle cx=\""); put(x);
+		put("\" cy=\""); put(-y);
+		put("\" r=\""); put(number_property(obj, SIZE, 1) / 2);
+		put("\"/>\n");
+		count++;
+	}
+	else if (name == "line") {
+		double x2, y2;
+		auto it = obj.tailConstBegin();
+		if (obj.tailConstEnd() - it != 2 || !point_coordinates(*it, x, y) || !point_coordinates(*(it + 1), x2, y2))
+			return;
+
+		put("<line x1=\""); put(x);
+		put("\" y1=\""); put(-y);
+		put("\" x2=\""); put(x2);
+		put("\" y2=\""); put(-y2);
+		put("\" stroke-width=\""); put(number_property(obj, THICKNESS, 1));
+		put("\"/>\n");
+		count++;
+	}
+	else if (name == "text") {
+		const Expression* position = obj.findProperty(POSITION);
+		if (obj.tailConstBegin() == obj.tailConstEnd() || !position || !point_coordinates(*position, x, y))
+			return;
+
+		put("<text x=\""); put(x);
+		put("\" y=\""); put(-y);
+		put("\" font-size=\""); put(number_property(obj, TEXT_SCALE, 1));
+		put("\" text-anchor=\"middle\" transform=\"rotate(");
+		put(number_property(obj, TEXT_ROTATION, 0) * 180 / 3.141592653589793);
+		put(" "); put(x); put(" "); put(-y);
+		put(")\">");
+		put_text(obj.tailConstBegin()->head().asSymbol());
+		put("</text>\n");
+		count++;
+	}
+	else if (name.empty() && !obj.packed()) {
+		for (auto it = obj.tailConstBegin(); it != obj.tailConstEnd(); it++)
+			emit(*it);
+	}
+}
+
+Expected<std::size_t> SvgWriter::write(const Expression& objects) {
+	Bounds bounds;
+	measure(objects, bounds);
+
+	double margin = 1;
+	put("<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"");
+	put(bounds.left - margin); put(" ");
+	put(bounds.top - margin); put(" ");
+	put(bounds.right - bounds.left + 2 * margin); put(" ");
+	put(bounds.bottom - bounds.top + 2 * margin);
+	put("\">\n<g fill=\"black\" stroke=\"black\">\n");
+
+	count = 0;
+	emit(objects);
+
+	put("</g>\n</svg>\n");
+
+	// the stream remembers any failed write, such as a full disk
+	bool failed = std::fflush(out) != 0 || std::ferror(out) != 0;
+	failed = std::fclose(out) != 0 || failed;
+	out = nullptr;
+	if (failed)
+		return Error("Error: could not write " + path);
+	return count;
+}
@@ -0,0 +1,184 @@
+#include "thread_pool.h"
+#include "budget.h"
+#include "memory.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+	constexpr std::size_t no_worker = static_cast<std::size_t>(-1);
+
+	thread_local ThreadPool* current_pool = nullptr;
+	thread_local const ThreadPool* owning_pool = nullptr;
+	thread_local std::size_t worker_index = no_worker;
+}
+
+ThreadPool::ThreadPool(std::size_t threads) : threads(threads) {
+	for (std::size_t i = 0; i < threads; i++)
+		queues.emplace_back(std::make_unique<Queue>());
+}
+
+void ThreadPool::start() {
+	std::call_once(started, [this] {
+		for (std::size_t i = 0; i < threads; i++)
+			workers.emplace_back(&ThreadPool::run_worker, this, i);
+	});
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& t : workers)
+		t.join();
+}
+
+std::size_t ThreadPool::size() const noexcept {
+	return threads;
+}
+
+ThreadPool* ThreadPool::current() noexcept {
+	return current_pool;
+}
+
+ThreadPool::Scope::Scope(ThreadPool* pool) noexcept : previous(current_pool) {
+	current_pool = pool;
+}
+
+ThreadPool::Scope::~Scope() {
+	current_pool = previous;
+}
+
+void ThreadPool::push(Task task) {
+
+	std::size_t target;
+	if (owning_pool == this)
+		target = worker_index;
+	else
+		target = next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+	{
+		std::lock_guard<std::mutex> guard(queues[target]->lock);
+		queues[target]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+		pending++;
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::try_run_one() {
+
+	Task task;
+	std::size_t home = owning_pool == this ? worker_index : 0;
+
+	for (std::size_t i = 0; i < queues.size() && !task; i++) {
+		Queue& q = *queues[(home + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(q.lock);
+		if (q.tasks.empty())
+			continue;
+
+		// own queue is LIFO for locality, stolen work comes from the cold end
+		if (i == 0 && owning_pool == this) {
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else {
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+	}
+
+	if (!task)
+		return false;
+
+	pending--;
+	task();
+	return true;
+}
+
+void ThreadPool::run_worker(std::size_t index) {
+	owning_pool = this;
+	worker_index = index;
+	current_pool = this;
+
+	while (true) {
+		if (try_run_one())
+			continue;
+
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		wake.wait(guard, [this] { return stopping || pending > 0; });
+		if (stopping && pending == 0)
+			return;
+	}
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& body) {
+
+	if (count == 0)
+		return;
+
+	if (threads == 0 || count == 1) {
+		for (std::size_t i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+	start();
+
+	// a few chunks per worker keeps stealing useful when iterations are uneven
+	std::size_t chunks = std::min(count, threads * 4);
+	std::size_t chunk_size = (count + chunks - 1) / chunks;
+	chunks = (count + chunk_size - 1) / chunk_size;
+
+	std::atomic<std::size_t> remaining(chunks);
+	std::mutex done_lock;
+	std::condition_variable done;
+	std::exception_ptr error;
+	std::mutex error_lock;
+	// chunks spend from the caller's budget, allocate on the caller's
+	// account and profile under the caller's frames, on whichever thread
+	// runs them
+	Budget* budget = Budget::current();
+	MemoryAccount* account = MemoryAccount::current();
+	profiler::Stack frames = profiler::capture();
+
+	for (std::size_t c = 0; c < chunks; c++) {
+		std::size_t begin = c * chunk_size;
+		std::size_t end = std::min(count, begin + chunk_size);
+
+		push([&, begin, end] {
+			Budget::Scope budgeting(budget);
+			MemoryAccount::Scope charging(account);
+			profiler::Adopt profiling(frames);
+			try {
+				for (std::size_t i = begin; i < end; i++)
+					body(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> guard(error_lock);
+				if (!error)
+					error = std::current_exception();
+			}
+			// under the lock, so the caller cannot return while this still
+			// holds references to its locals
+			std::lock_guard<std::mutex> guard(done_lock);
+			if (--remaining == 0)
+				done.notify_all();
+		});
+	}
+
+	// Help until no chunk is left queued; the rest are running on workers,
+	// which handle anything those chunks push, so sleep until they finish.
+	while (remaining > 0 && try_run_one()) {
+	}
+	std::unique_lock<std::mutex> guard(done_lock);
+	done.wait(guard, [&] { return remaining == 0; });
+
+	if (error)
+		std::rethrow_exception(error);
+}
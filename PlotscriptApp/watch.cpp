@@ -0,0 +1,269 @@
+#include "watch.h"
+#include "builtins.h"
+#include "token.h"
+#include "parse.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <map>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace watch {
+
+namespace {
+	// Where the forms inside a (begin ...) start, or npos if program is not one.
+	std::size_t begin_body(const std::string& program) {
+		const std::string BEGIN = "begin";
+		auto space = [&](std::size_t i) {
+			return i < program.size() && std::isspace(static_cast<unsigned char>(program[i]));
+		};
+
+		if (program.size() < 2 || program.front() != OPEN_CHAR || program.back() != CLOSE_CHAR)
+			return std::string::npos;
+		std::size_t i = 1;
+		while (space(i))
+			i++;
+		if (program.compare(i, BEGIN.size(), BEGIN) != 0)
+			return std::string::npos;
+		i += BEGIN.size();
+		if (!space(i) && program[i] != OPEN_CHAR && program[i] != CLOSE_CHAR && program[i] != COMMENT_CHAR)
+			return std::string::npos;
+		return i;
+	}
+
+	bool is_symbol(const Expression& exp, const char* name) {
+		return exp.head().isSymbol() && exp.head().asSymbol() == name;
+	}
+
+	// Special forms and builtins, which no define can rebind.
+	bool is_fixed(const Atom& symbol) {
+		std::string name = symbol.asSymbol();
+		return name == "define" || name == "begin" || name == "lambda" || builtins::find(name) != nullptr;
+	}
+
+	// Every symbol in exp that a define could bind, except the names it
+	// defines, which it does not read.
+	void collect_mentions(const Expression& exp, std::set<Atom>& mentions) {
+		if (exp.head().isSymbol() && !is_fixed(exp.head()))
+			mentions.insert(exp.head());
+
+		auto child = exp.tailConstBegin();
+		if (is_symbol(exp, "define") && child != exp.tailConstEnd())
+			child++;
+		for (; child != exp.tailConstEnd(); child++)
+			collect_mentions(*child, mentions);
+	}
+
+	// The names exp defines wherever it is evaluated. A lambda's body runs in a
+	// copy of its caller's environment, so what it defines stays there.
+	void collect_defines(const Expression& exp, std::set<Atom>& defines) {
+		if (is_symbol(exp, "lambda"))
+			return;
+		if (is_symbol(exp, "define") && exp.tailConstBegin() != exp.tailConstEnd()
+			&& exp.tailConstBegin()->head().isSymbol())
+			defines.insert(exp.tailConstBegin()->head());
+
+		for (auto child = exp.tailConstBegin(); child != exp.tailConstEnd(); child++)
+			collect_defines(*child, defines);
+	}
+
+	// What calling a lambda value reads: its body's symbols, less its parameters.
+	void collect_lambda_mentions(const Expression& lambda, std::set<Atom>& mentions) {
+		if (lambda.tailConstEnd() - lambda.tailConstBegin() != 2)
+			return;
+		const Expression& parameters = *lambda.tailConstBegin();
+		std::set<Atom> body;
+		collect_mentions(*(lambda.tailConstBegin() + 1), body);
+		for (auto parameter = parameters.tailConstBegin(); parameter != parameters.tailConstEnd(); parameter++)
+			body.erase(parameter->head());
+		mentions.insert(body.begin(), body.end());
+	}
+
+	bool same(const std::vector<std::pair<Atom, Expression>>& a, const std::vector<std::pair<Atom, Expression>>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+			return x.first == y.first && x.second.identical(y.second);
+		});
+	}
+}
+
+std::vector<batch::Job> split(const std::string& text) {
+	std::vector<batch::Job> jobs = batch::split(text);
+	if (jobs.size() != 1)
+		return jobs;
+
+	const batch::Job& script = jobs.front();
+	std::size_t body = begin_body(script.program);
+	if (body == std::string::npos)
+		return jobs;
+
+	std::size_t first_line = script.line + static_cast<std::size_t>(
+		std::count(script.program.begin(), script.program.begin() + static_cast<std::ptrdiff_t>(body), '\n'));
+	std::vector<batch::Job> forms = batch::split(script.program.substr(body, script.program.size() - body - 1));
+	for (auto& form : forms)
+		form.line += first_line - 1;
+	return forms;
+}
+
+Session::Session(Interpreter& base) : base(base) {
+}
+
+Session::Form Session::read(const batch::Job& job) {
+	Form form;
+	form.text = job.program;
+	form.line = job.line;
+
+	std::istringstream stream(job.program);
+	form.program = parse(tokenize(stream));
+	form.parsed = form.program != Expression();
+	if (!form.parsed) {
+		form.outcome = Error("Invalid Program. Could not parse.");
+		return form;
+	}
+
+	std::set<Atom> defines, mentions;
+	collect_defines(form.program, defines);
+	collect_mentions(form.program, mentions);
+	form.defines.assign(defines.begin(), defines.end());
+	form.mentions.assign(mentions.begin(), mentions.end());
+	return form;
+}
+
+Report Session::update(const std::string& text) {
+	std::vector<batch::Job> jobs = split(text);
+
+	// Forms up to the first edit are unchanged and so are their results; the
+	// walk below resumes from the last checkpoint before the edit.
+	std::size_t prefix = 0;
+	while (prefix < jobs.size() && prefix < forms.size() && forms[prefix].text == jobs[prefix].program) {
+		forms[prefix].line = jobs[prefix].line;
+		prefix++;
+	}
+
+	if (checkpoints.empty())
+		checkpoints.push_back(base.fork());
+	std::size_t resume = std::min(prefix / CHECKPOINT, checkpoints.size() - 1);
+	checkpoints.erase(checkpoints.begin() + static_cast<std::ptrdiff_t>(resume) + 1, checkpoints.end());
+	Interpreter running = checkpoints[resume].fork();
+
+	struct Evaluating {
+		std::atomic<Interpreter*>& slot;
+		~Evaluating() { slot.store(nullptr); }
+	} in_progress{ evaluating };
+	evaluating.store(&running);
+
+	Report report;
+	report.forms = jobs.size();
+
+	for (std::size_t i = resume * CHECKPOINT; i < prefix; i++) {
+		for (const auto& [name, value] : forms[i].bindings)
+			(void)running.bind(name, value);
+		report.replayed++;
+	}
+
+	// the old forms after the prefix by text, to be taken in script order
+	std::unordered_map<std::string, std::vector<std::size_t>> unchanged;
+	for (std::size_t i = forms.size(); i-- > prefix;)
+		unchanged[forms[i].text].push_back(i);
+
+	std::vector<Form> suffix;
+	std::vector<bool> kept;
+	suffix.reserve(jobs.size() - prefix);
+	kept.reserve(jobs.size() - prefix);
+	for (std::size_t i = prefix; i < jobs.size(); i++) {
+		const batch::Job& job = jobs[i];
+		auto found = unchanged.find(job.program);
+		if (found != unchanged.end() && !found->second.empty()) {
+			suffix.push_back(std::move(forms[found->second.back()]));
+			found->second.pop_back();
+			suffix.back().line = job.line;
+			kept.push_back(true);
+		}
+		else {
+			suffix.push_back(read(job));
+			kept.push_back(false);
+		}
+	}
+	forms.resize(prefix);
+
+	for (std::size_t k = 0; k < suffix.size(); k++) {
+		Form& form = suffix[k];
+		std::size_t i = prefix + k;
+		if (i % CHECKPOINT == 0 && i / CHECKPOINT == checkpoints.size())
+			checkpoints.push_back(running.fork());
+
+		// A lambda's body looks its names up where it is called, so a form that
+		// mentions a lambda also reads what the body mentions, as bound here.
+		std::map<Atom, Expression> reads;
+		std::vector<Atom> pending(form.mentions.begin(), form.mentions.end());
+		while (!pending.empty()) {
+			Atom name = pending.back();
+			pending.pop_back();
+			if (reads.count(name) != 0)
+				continue;
+			std::optional<Expression> value = running.binding(name);
+			if (!value)
+				continue;
+
+			if (is_symbol(*value, "lambda")) {
+				std::set<Atom> body;
+				collect_lambda_mentions(*value, body);
+				pending.insert(pending.end(), body.begin(), body.end());
+			}
+			reads.emplace(std::move(name), std::move(*value));
+		}
+		std::vector<std::pair<Atom, Expression>> inputs(reads.begin(), reads.end());
+
+		// values reused from the last update share storage, so this is cheap
+		// for everything the edit left alone
+		bool stale = !kept[k] || !same(inputs, form.inputs);
+		form.inputs = std::move(inputs);
+
+		if (!stale) {
+			for (const auto& [name, value] : form.bindings)
+				(void)running.bind(name, value);
+			report.replayed++;
+		}
+		else if (form.parsed) {
+			report.evaluated++;
+			try {
+				form.outcome = running.try_evaluate(form.program);
+			}
+			catch (std::exception& e) {
+				form.outcome = Error(e.what());
+			}
+			if (!form.outcome)
+				report.failures.push_back({ form.line, form.outcome.error().message() });
+			if (!form.outcome && form.outcome.error().stop() == Stop::Cancelled) {
+				// leave this form and the rest out, so the next update runs them
+				report.result = form.outcome;
+				return report;
+			}
+
+			form.bindings.clear();
+			for (const auto& name : form.defines) {
+				if (auto value = running.binding(name))
+					form.bindings.emplace_back(name, *value);
+			}
+		}
+		else {
+			report.evaluated++;
+			report.failures.push_back({ form.line, form.outcome.error().message() });
+		}
+
+		forms.push_back(std::move(form));
+	}
+
+	if (!forms.empty())
+		report.result = forms.back().outcome;
+	return report;
+}
+
+bool Session::interrupt() noexcept {
+	Interpreter* running = evaluating.load();
+	return running != nullptr && running->interrupt();
+}
+
+}
@@ -0,0 +1,52 @@
+// Loads a generated numeric CSV through read-csv's loader and reports MB/s.
+#include "csv.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+template <typename F>
+double time_ms(F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::size_t rows = argc > 1 ? std::stoul(argv[1]) : 5000000;
+	std::string path = "bench_csv.csv";
+
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<double> value(-1000, 1000);
+		std::ofstream out(path);
+		out << std::setprecision(10) << "t,x,y\n";
+		for (std::size_t i = 0; i < rows; i++)
+			out << i << "," << value(random) << "," << value(random) << "\n";
+	}
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	double megabytes = static_cast<double>(in.tellg()) / (1 << 20);
+
+	ThreadPool pool;
+	ThreadPool::Scope scope(&pool);
+
+	std::size_t loaded = 0;
+	double elapsed = time_ms([&] {
+		auto columns = csv::read(path);
+		if (columns)
+			loaded = (*columns)[0].size();
+	});
+	std::remove(path.c_str());
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< loaded << " rows, " << megabytes << " MB in " << elapsed << " ms on " << pool.size() << " threads ("
+		<< megabytes / elapsed * 1000 << " MB/s)\n";
+
+	return loaded == rows ? EXIT_SUCCESS : EXIT_FAILURE;
+}
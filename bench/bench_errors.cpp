@@ -0,0 +1,66 @@
+// Error-heavy workloads through the throwing and the Result-based entry points.
+#include "environment.h"
+#include "expression.h"
+#include "parse.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+Expression parse_program(const std::string& text) {
+	std::istringstream stream(text);
+	return parse(tokenize(stream));
+}
+
+template <typename F>
+double time_ms(F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	int jobs = argc > 1 ? std::stoi(argv[1]) : 100000;
+
+	Environment env;
+	env.add_exp(Atom("f"), parse_program("(lambda (x) (first x))").eval(env));
+
+	const std::pair<std::string, std::string> workloads[] = {
+		{ "arity error", "(sqrt 1 2)" },
+		{ "type error", "(first 5)" },
+		{ "error in mapped lambda", "(map f (list 1 2 3))" },
+	};
+
+	for (const auto& [name, text] : workloads) {
+		Expression program = parse_program(text);
+		int failures = 0;
+
+		double throwing = time_ms([&] {
+			for (int i = 0; i < jobs; i++) {
+				try {
+					program.eval(env);
+				}
+				catch (SemanticError&) {
+					failures++;
+				}
+			}
+		});
+
+		double result = time_ms([&] {
+			for (int i = 0; i < jobs; i++) {
+				if (!program.evaluate(env))
+					failures++;
+			}
+		});
+
+		std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+			<< " throwing " << std::setw(8) << throwing << " ms"
+			<< "   result " << std::setw(8) << result << " ms"
+			<< "   (" << std::setprecision(2) << throwing / result << "x, " << failures << " errors)\n";
+	}
+
+	return EXIT_SUCCESS;
+}
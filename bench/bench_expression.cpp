@@ -0,0 +1,104 @@
+// Size of an expression node and what building and evaluating trees costs:
+// bytes allocated per parsed node, heap allocations per evaluated node, and
+// the time of a lambda call, which copies the lambda's body on every call.
+#include "interpreter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+// Every heap allocation in the process, the interpreter's and the standard
+// library's alike.
+std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* block = std::malloc(size == 0 ? 1 : size))
+		return block;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+	std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+	std::free(block);
+}
+
+// Heap allocations made by one run of body, averaged over runs.
+template <typename F>
+double allocations_per_run(int runs, F&& body) {
+	std::size_t before = allocations.load(std::memory_order_relaxed);
+	for (int i = 0; i < runs; i++)
+		body();
+	return static_cast<double>(allocations.load(std::memory_order_relaxed) - before) / runs;
+}
+
+template <typename F>
+double time_us(int runs, F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(stop - start).count() / runs;
+}
+
+// A program of nested calls, mostly with two children: (+ (* 1 2) (* 3 4) ...)
+std::string arithmetic(int terms) {
+	std::ostringstream text;
+	text << "(+";
+	for (int i = 0; i < terms; i++)
+		text << " (* " << i << " (- " << i << " 1))";
+	text << ")";
+	return text.str();
+}
+
+int main(int argc, char* argv[]) {
+	int runs = argc > 1 ? std::stoi(argv[1]) : 200;
+	const int terms = 1000;
+	// the head of every term and of its two calls, and their five leaves
+	const double nodes = 1 + terms * 7.0;
+
+	std::string program = arithmetic(terms);
+	auto account = MemoryAccount::open();
+
+	Expression tree;
+	double parsing = time_us(runs, [&] {
+		std::istringstream stream(program);
+		MemoryAccount::Scope charging(account.get());
+		tree = parse(tokenize(stream));
+	});
+	std::size_t held = account->usage().current;
+
+	Environment env;
+	double evaluate = time_us(runs, [&] { tree.evaluate(env); });
+	double evaluating = allocations_per_run(runs, [&] { tree.evaluate(env); });
+	double copy = time_us(runs, [&] { Expression duplicate = tree; });
+
+	Interpreter interp(1);
+	std::string define = "(define f (lambda (x) (+ (* x x) (- x 1) (/ x 2))))";
+	interp.interpret(define);
+	interp.evaluate();
+	std::string calls = "(length (map f (range 0 999)))";
+	interp.interpret(calls);
+	double lambda = time_us(runs / 10 + 1, [&] { interp.evaluate(); }) / 1000;
+	double calling = allocations_per_run(runs / 10 + 1, [&] { interp.evaluate(); }) / 1000;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "sizeof(Expression)          " << std::setw(10) << sizeof(Expression) << " bytes\n"
+		<< "parsed tree, per node       " << std::setw(10) << static_cast<double>(held) / nodes << " bytes\n"
+		<< "parse, per node             " << std::setw(10) << parsing * 1000 / nodes << " ns\n"
+		<< "evaluate, per node          " << std::setw(10) << evaluate * 1000 / nodes << " ns\n"
+		<< "allocations, per 1000 nodes " << std::setw(10) << evaluating * 1000 / nodes << " evaluated\n"
+		<< "copy tree                   " << std::setw(10) << copy << " us\n"
+		<< "lambda call                 " << std::setw(10) << lambda << " us\n"
+		<< "allocations, per lambda call" << std::setw(10) << calling << "\n";
+
+	return EXIT_SUCCESS;
+}
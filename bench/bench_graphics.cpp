@@ -0,0 +1,80 @@
+// Builds graphics objects through the native constructors and through the
+// lambdas startup.script used to define for them.
+#include "environment.h"
+#include "expression.h"
+#include "parse.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+Expression parse_program(const std::string& text) {
+	std::istringstream stream(text);
+	return parse(tokenize(stream));
+}
+
+template <typename F>
+double time_ms(F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+const char* SCRIPT_CONSTRUCTORS = R"((begin
+(define script-point (lambda (x y)
+	(set-property "size" (1) (set-property "object-name" "point" (list (+ 0 x) (+ 0 y))))))
+(define script-line (lambda (start end)
+	(set-property "thickness" (1) (set-property "object-name" "line" (list start end)))))
+(define script-text (lambda (str)
+	(set-property "position" (script-point 0 0) (set-property "object-name" "text"
+	(set-property "text-scale" 1 (set-property "text-rotation" 0 (list str)))))))
+))";
+
+int main(int argc, char* argv[]) {
+	int jobs = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+	Environment env;
+	parse_program(SCRIPT_CONSTRUCTORS).eval(env);
+
+	const std::pair<std::string, std::string> workloads[] = {
+		{ "point", "(%-point 1 2)" },
+		{ "line", "(%-line (%-point 0 0) (%-point 1 1))" },
+		{ "text", "(%-text \"label\")" },
+	};
+
+	for (const auto& [name, pattern] : workloads) {
+		auto program = [&](const std::string& prefix) {
+			std::string text = pattern;
+			for (auto at = text.find('%'); at != std::string::npos; at = text.find('%'))
+				text.replace(at, 1, prefix);
+			return parse_program(text);
+		};
+		Expression script = program("script");
+		Expression native = program("make");
+
+		if (script.eval(env) != native.eval(env)) {
+			std::cerr << name << ": script and native constructors disagree\n";
+			return EXIT_FAILURE;
+		}
+
+		double script_ms = time_ms([&] {
+			for (int i = 0; i < jobs; i++)
+				script.eval(env);
+		});
+
+		double native_ms = time_ms([&] {
+			for (int i = 0; i < jobs; i++)
+				native.eval(env);
+		});
+
+		std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+			<< " script " << std::setw(8) << script_ms << " ms"
+			<< "   native " << std::setw(8) << native_ms << " ms"
+			<< "   (" << std::setprecision(2) << script_ms / native_ms << "x)\n";
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+// Whole-list kernels against the per-element builtin path they replace.
+#include "environment.h"
+#include "expression.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+template <typename F>
+double time_ms(F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+Expression numbers(int size, double offset) {
+	std::vector<Expression> items;
+	for (int i = 0; i < size; i++)
+		items.emplace_back(Atom(offset + i));
+	return { Atom("list"), items };
+}
+
+void report(const std::string& name, double per_element, double kernel) {
+	std::cout << std::left << std::setw(6) << name << std::right << std::fixed << std::setprecision(2)
+		<< " per-element " << std::setw(9) << per_element << " ms"
+		<< "   kernel " << std::setw(8) << kernel << " ms"
+		<< "   (" << per_element / kernel << "x)\n";
+}
+
+int main(int argc, char* argv[]) {
+	int size = argc > 1 ? std::stoi(argv[1]) : 1000000;
+	Environment env;
+
+	Expression a = numbers(size, 1);
+	Expression b = numbers(size, 2);
+
+	std::cout << size << " elements\n";
+
+	for (const std::string name : { "sqrt", "sin", "ln" }) {
+		Atom proc(name);
+
+		double per_element = time_ms([&] {
+			std::vector<Expression> result;
+			for (auto it = a.tailConstBegin(); it != a.tailConstEnd(); it++)
+				result.push_back(Expression::apply(proc, { *it }, env));
+		});
+
+		Expression program(Atom("map"), { Expression(proc), Expression(Atom("data")) });
+		env.add_exp(Atom("data"), a);
+		double kernel = time_ms([&] { program.eval(env); });
+
+		report(name, per_element, kernel);
+	}
+
+	for (const std::string name : { "+", "-", "*", "/" }) {
+		Atom proc(name);
+
+		double per_element = time_ms([&] {
+			std::vector<Expression> result;
+			auto r = b.tailConstBegin();
+			for (auto l = a.tailConstBegin(); l != a.tailConstEnd(); l++, r++)
+				result.push_back(Expression::apply(proc, { *l, *r }, env));
+		});
+
+		double kernel = time_ms([&] { Expression::apply(proc, { a, b }, env); });
+
+		report(name, per_element, kernel);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+// Scaling benchmark for pmap: times the same map at increasing pool sizes.
+#include "interpreter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+double time_program(std::size_t threads, const std::string& program) {
+	Interpreter interp(threads);
+
+	std::string text = program;
+	if (!interp.interpret(text)) {
+		std::cerr << "Could not parse benchmark program.\n";
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	interp.evaluate();
+	auto stop = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+std::string program(const std::string& mapper, int size) {
+	return "(begin"
+		" (define f (lambda (x) (+ (sin x) (cos x) (sqrt (* x x)) (^ x 2) (log (+ x 10)) (tan x))))"
+		" (" + mapper + " f (range 0 " + std::to_string(size) + ")))";
+}
+
+int main(int argc, char* argv[]) {
+	int size = argc > 1 ? std::stoi(argv[1]) : 20000;
+	std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	double serial = time_program(0, program("map", size));
+	std::cout << "map, " << size << " elements: " << std::fixed << std::setprecision(1) << serial << " ms\n";
+
+	for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+		double ms = time_program(threads, program("pmap", size));
+		std::cout << "pmap, " << threads << " threads: " << ms << " ms"
+			<< " (speedup " << std::setprecision(2) << serial / ms << "x)\n" << std::setprecision(1);
+	}
+
+	return EXIT_SUCCESS;
+}
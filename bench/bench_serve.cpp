@@ -0,0 +1,144 @@
+// Request latency and throughput of plotscript --serve, against starting a
+// plotscript -e process for every request.
+#include "server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+double micros(Clock::duration d) {
+	return std::chrono::duration<double, std::micro>(d).count();
+}
+
+struct Summary {
+	double mean = 0, p50 = 0, p99 = 0, per_second = 0;
+};
+
+Summary summarize(std::vector<double> latencies, double total_us) {
+	Summary s;
+	std::sort(latencies.begin(), latencies.end());
+	for (double l : latencies)
+		s.mean += l;
+	s.mean /= static_cast<double>(latencies.size());
+	s.p50 = latencies[latencies.size() / 2];
+	s.p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+	s.per_second = static_cast<double>(latencies.size()) / (total_us / 1e6);
+	return s;
+}
+
+void report(const std::string& name, const Summary& s) {
+	std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(28) << name << std::right
+		<< std::setw(10) << s.mean << std::setw(10) << s.p50 << std::setw(10) << s.p99
+		<< std::setw(12) << s.per_second << "\n";
+}
+
+// Runs plotscript -e program with its output discarded.
+bool spawn_once(const std::string& program) {
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+	std::string binary = PLOTSCRIPT_BINARY;
+	std::vector<char*> argv{ binary.data(), const_cast<char*>("--threads"), const_cast<char*>("1"),
+		const_cast<char*>("-e"), const_cast<char*>(program.c_str()), nullptr };
+
+	pid_t pid;
+	int spawned = posix_spawn(&pid, binary.c_str(), &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (spawned != 0)
+		return false;
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char* argv[]) {
+	int requests = argc > 1 ? std::stoi(argv[1]) : 2000;
+	int spawns = argc > 2 ? std::stoi(argv[2]) : 200;
+	std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+
+	const std::string program = argc > 3 ? argv[3] : "(begin (define f (lambda (x) (* x x))) (map f (range 0 20)))";
+	std::string path = "/tmp/plotscript_bench_" + std::to_string(getpid()) + ".sock";
+
+	Server server(path, workers, 1);
+	std::thread serving([&] { server.run(); });
+
+	// wait for the socket to come up
+	std::unique_ptr<Client> client;
+	for (int attempt = 0; attempt < 500 && !(client && client->is_open()); attempt++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		client = std::make_unique<Client>(path);
+	}
+	if (!client->is_open()) {
+		std::cerr << "could not connect to the server\n";
+		server.stop();
+		serving.join();
+		return EXIT_FAILURE;
+	}
+
+	std::cout << requests << " daemon requests, " << spawns << " process launches, " << workers << " workers\n"
+		<< std::left << std::setw(28) << "" << std::right << std::setw(10) << "mean us" << std::setw(10) << "p50 us"
+		<< std::setw(10) << "p99 us" << std::setw(12) << "req/s" << "\n";
+
+	// one request at a time
+	std::vector<double> latencies;
+	auto start = Clock::now();
+	for (int i = 0; i < requests; i++) {
+		auto sent = Clock::now();
+		client->send(program);
+		client->receive();
+		latencies.push_back(micros(Clock::now() - sent));
+	}
+	report("daemon, sequential", summarize(latencies, micros(Clock::now() - start)));
+
+	// everything sent before the first read; latency is send to response
+	latencies.clear();
+	std::vector<Clock::time_point> sent(requests);
+	start = Clock::now();
+	std::thread sender([&] {
+		for (int i = 0; i < requests; i++) {
+			sent[i] = Clock::now();
+			client->send(program);
+		}
+	});
+	std::vector<Clock::time_point> received(requests);
+	for (int i = 0; i < requests; i++) {
+		client->receive();
+		received[i] = Clock::now();
+	}
+	sender.join();
+	for (int i = 0; i < requests; i++)
+		latencies.push_back(micros(received[i] - sent[i]));
+	report("daemon, pipelined", summarize(latencies, micros(received.back() - start)));
+
+	server.stop();
+	serving.join();
+
+	latencies.clear();
+	start = Clock::now();
+	for (int i = 0; i < spawns; i++) {
+		auto launched = Clock::now();
+		if (!spawn_once(program)) {
+			std::cerr << "could not run " << PLOTSCRIPT_BINARY << "\n";
+			return EXIT_FAILURE;
+		}
+		latencies.push_back(micros(Clock::now() - launched));
+	}
+	report("process per request", summarize(latencies, micros(Clock::now() - start)));
+
+	return EXIT_SUCCESS;
+}
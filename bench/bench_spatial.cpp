@@ -0,0 +1,65 @@
+// Viewport queries through a spatial index against scanning every object.
+#include "graphics.h"
+#include "spatial.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+template <typename F>
+double time_ms(F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+	int queries = 100;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<double> coordinate(0, 1000);
+
+	std::vector<Expression> points;
+	for (std::size_t i = 0; i < count; i++)
+		points.push_back(make_point(coordinate(random), coordinate(random)));
+	Expression objects(Atom("list"), points);
+
+	ThreadPool pool;
+	ThreadPool::Scope scope(&pool);
+
+	std::shared_ptr<const SpatialIndex> index;
+	double build = time_ms([&] { index = *SpatialIndex::build(objects); });
+
+	std::size_t found = 0;
+	double indexed = time_ms([&] {
+		for (int q = 0; q < queries; q++) {
+			double x = coordinate(random), y = coordinate(random);
+			found += index->query({ x, y, x + 20, y + 20 }).size();
+		}
+	});
+
+	std::size_t scanned = 0;
+	double scan = time_ms([&] {
+		for (int q = 0; q < queries; q++) {
+			double x = coordinate(random), y = coordinate(random);
+			for (const auto& point : points) {
+				double px, py;
+				point_coordinates(point, px, py);
+				if (px >= x && px <= x + 20 && py >= y && py <= y + 20)
+					scanned++;
+			}
+		}
+	});
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< count << " points, build " << build << " ms on " << pool.size() << " threads\n"
+		<< queries << " viewport queries: index " << indexed << " ms (" << found << " hits)"
+		<< ", scan " << scan << " ms (" << scanned << " hits)\n";
+
+	return EXIT_SUCCESS;
+}
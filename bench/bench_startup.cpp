@@ -0,0 +1,48 @@
+// Interpreter start-up latency, against the work the constructor used to do
+// reading, tokenizing and parsing startup.script on every launch, and the cost
+// of forking a session from a loaded one.
+#include "interpreter.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+template <typename F>
+double time_us(int runs, F&& body) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		body();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(stop - start).count() / runs;
+}
+
+int main(int argc, char* argv[]) {
+	int runs = argc > 1 ? std::stoi(argv[1]) : 2000;
+
+	double embedded = time_us(runs, [] { Interpreter interp(1); });
+	double pooled = time_us(runs, [] { Interpreter interp; });
+
+	Interpreter loaded(1);
+	std::string data = "(define data (range 0 1000000))";
+	loaded.interpret(data);
+	loaded.evaluate();
+	double forked = time_us(runs, [&] { Interpreter session = loaded.fork(); });
+
+	double environment = time_us(runs, [] { Environment env; });
+	double from_file = time_us(runs, [] {
+		Environment env;
+		std::ifstream script(STARTUP_SCRIPT);
+		parse(tokenize(script)).eval(env);
+	});
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "Interpreter(1)             " << std::setw(8) << embedded << " us\n"
+		<< "Interpreter() with pool    " << std::setw(8) << pooled << " us\n"
+		<< "fork() with 1M-item data   " << std::setw(8) << forked << " us\n"
+		<< "Environment alone          " << std::setw(8) << environment << " us\n"
+		<< "Environment + script file  " << std::setw(8) << from_file << " us\n";
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compares two plotscript_bench JSON files and flags regressions.
+
+    python3 bench/compare.py bench/baseline.json results.json [--threshold 0.25]
+
+A case regresses when its median is slower than the baseline's by more than
+the threshold, as a fraction, and by more than --min-ms, which keeps the
+noise of very short cases out. Exits with 1 if any case regressed, so the
+script can gate a build. The default threshold allows for the run-to-run
+spread of a shared machine; on a quiet one, 0.10 is a useful setting.
+
+baseline.json is only meaningful for the build type and machine it was
+recorded on; record a new one with plotscript_bench --out bench/baseline.json
+after changing either.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return {(r["case"], r["size"]): r for r in data["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.25,
+                        help="slowdown, as a fraction, that counts as a regression")
+    parser.add_argument("--min-ms", type=float, default=0.5,
+                        help="smallest slowdown in milliseconds that counts")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    print(f"{'case':<20}{'size':>9}{'baseline ms':>14}{'current ms':>14}{'change':>9}")
+    for key in sorted(set(baseline) | set(current)):
+        name, size = key
+        if key not in current:
+            print(f"{name:<20}{size:>9}   missing from {args.current}")
+            continue
+        if key not in baseline:
+            print(f"{name:<20}{size:>9}   new, no baseline")
+            continue
+
+        before = baseline[key]["median_ms"]
+        after = current[key]["median_ms"]
+        change = (after - before) / before if before > 0 else 0.0
+
+        verdict = ""
+        if change > args.threshold and after - before > args.min_ms:
+            verdict = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold and before - after > args.min_ms:
+            verdict = "  faster"
+
+        print(f"{name:<20}{size:>9}{before:>14.3f}{after:>14.3f}{change:>+9.1%}{verdict}")
+
+    if regressions:
+        print(f"{regressions} regression(s) over {args.threshold:.0%}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
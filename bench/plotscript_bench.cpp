@@ -0,0 +1,193 @@
+// The benchmark suite: every stage of the interpreter at several input sizes,
+// printed as JSON so that runs can be compared with compare.py.
+//
+//   plotscript_bench [--repeat <n>] [--filter <text>] [--out <file>]
+//   python3 bench/compare.py bench/baseline.json results.json
+//
+// Inputs are generated the same way on every run. Each measurement is the
+// median of --repeat timed runs after one untimed warm-up; setup such as
+// building the list to print is done outside the timing.
+#include "interpreter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Body = std::function<void()>;
+
+struct Case {
+	std::string name;
+	std::vector<std::size_t> sizes;
+	// Builds the input for a size; the returned body is what gets timed.
+	std::function<Body(std::size_t)> prepare;
+};
+
+struct Measurement {
+	std::string name;
+	std::size_t size;
+	double median_ms;
+	double min_ms;
+};
+
+// An interpreter that has already evaluated setup, if there is any.
+std::shared_ptr<Interpreter> loaded(const std::string& setup = "") {
+	auto interp = std::make_shared<Interpreter>(1);
+	if (!setup.empty()) {
+		std::string text = setup;
+		interp->interpret(text);
+		interp->evaluate();
+	}
+	return interp;
+}
+
+// Evaluates program in interp each time the body runs.
+Body evaluating(std::shared_ptr<Interpreter> interp, const std::string& program) {
+	return [interp, program] {
+		std::string text = program;
+		interp->interpret(text);
+		interp->evaluate();
+	};
+}
+
+Body parsing(std::string program) {
+	return [program] {
+		std::istringstream stream(program);
+		Expression tree = parse(tokenize(stream));
+		if (tree.isEmpty())
+			throw std::runtime_error("benchmark program did not parse");
+	};
+}
+
+std::vector<Case> suite() {
+	std::vector<Case> cases;
+
+	cases.push_back({ "parse-literal", { 1000, 10000, 100000 }, [](std::size_t n) {
+		std::ostringstream text;
+		text << "(list";
+		for (std::size_t i = 0; i < n; i++)
+			text << " " << i * 0.5;
+		text << ")";
+		return parsing(text.str());
+	} });
+
+	cases.push_back({ "parse-nested", { 100, 500, 2000 }, [](std::size_t depth) {
+		std::string text;
+		for (std::size_t i = 0; i < depth; i++)
+			text += "(+ 1 ";
+		text += "0" + std::string(depth, ')');
+		return parsing(text);
+	} });
+
+	cases.push_back({ "eval-nested", { 100, 500, 2000 }, [](std::size_t depth) {
+		std::string text;
+		for (std::size_t i = 0; i < depth; i++)
+			text += "(+ 1 ";
+		text += "0" + std::string(depth, ')');
+		return evaluating(loaded(), text);
+	} });
+
+	cases.push_back({ "lambda-arithmetic", { 100, 1000, 10000 }, [](std::size_t n) {
+		auto interp = loaded("(define f (lambda (x) (+ (* x x) (- x 1) (/ x 2))))");
+		return evaluating(interp, "(map f (range 0 " + std::to_string(n - 1) + "))");
+	} });
+
+	cases.push_back({ "map-range", { 10000, 100000, 1000000 }, [](std::size_t n) {
+		return evaluating(loaded(), "(map sqrt (range 0 " + std::to_string(n - 1) + "))");
+	} });
+
+	cases.push_back({ "make-point", { 100, 1000, 10000 }, [](std::size_t n) {
+		auto interp = loaded("(define p (lambda (x) (set-property \"size\" 2 (make-point x (* x x)))))");
+		return evaluating(interp, "(map p (range 0 " + std::to_string(n - 1) + "))");
+	} });
+
+	cases.push_back({ "print-list", { 10000, 100000, 1000000 }, [](std::size_t n) {
+		auto interp = loaded("(define data (range 0 " + std::to_string(n - 1) + "))");
+		std::string name = "(data)";
+		interp->interpret(name);
+		Expression data = interp->evaluate();
+		return Body([data] {
+			std::ostringstream out;
+			out << data;
+		});
+	} });
+
+	return cases;
+}
+
+Measurement measure(const std::string& name, std::size_t size, const Body& body, int repeat) {
+	body();
+
+	std::vector<double> times;
+	for (int i = 0; i < repeat; i++) {
+		auto start = std::chrono::steady_clock::now();
+		body();
+		auto stop = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+	}
+
+	std::sort(times.begin(), times.end());
+	return { name, size, times[times.size() / 2], times.front() };
+}
+
+void write_json(std::ostream& out, const std::vector<Measurement>& results, int repeat) {
+	out << std::fixed << std::setprecision(4);
+	out << "{\n  \"suite\": \"plotscript_bench\",\n  \"repeat\": " << repeat << ",\n  \"results\": [\n";
+	for (std::size_t i = 0; i < results.size(); i++) {
+		const auto& r = results[i];
+		out << "    { \"case\": \"" << r.name << "\", \"size\": " << r.size
+			<< ", \"median_ms\": " << r.median_ms << ", \"min_ms\": " << r.min_ms << " }"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+	int repeat = 5;
+	std::string filter, out_path;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--repeat" && i + 1 < argc)
+			repeat = std::max(1, std::stoi(argv[++i]));
+		else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "--out" && i + 1 < argc)
+			out_path = argv[++i];
+		else {
+			std::cerr << "usage: plotscript_bench [--repeat <n>] [--filter <text>] [--out <file>]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<Measurement> results;
+	for (const auto& c : suite()) {
+		if (c.name.find(filter) == std::string::npos)
+			continue;
+		for (std::size_t size : c.sizes) {
+			results.push_back(measure(c.name, size, c.prepare(size), repeat));
+			const auto& r = results.back();
+			std::cerr << std::left << std::setw(20) << r.name << std::right << std::setw(9) << r.size
+				<< std::fixed << std::setprecision(3) << std::setw(12) << r.median_ms << " ms\n";
+		}
+	}
+
+	if (out_path.empty()) {
+		write_json(std::cout, results, repeat);
+	}
+	else {
+		std::ofstream out(out_path);
+		if (!out) {
+			std::cerr << "Could not open " << out_path << " for writing.\n";
+			return EXIT_FAILURE;
+		}
+		write_json(out, results, repeat);
+	}
+
+	return EXIT_SUCCESS;
+}
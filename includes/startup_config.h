@@ -1,8 +0,0 @@
-#ifndef STARTUP_CONFIG_HPP
-#define STARTUP_CONFIG_HPP
-
-#include <string>
-
-const std::string STARTUP_FILE = "PlotscriptApp/includes/startup.script";
-
-#endif
@@ -17,6 +17,13 @@ TEST_CASE("Test atom constructors") {
 		CHECK(!a.isSymbol());
 		CHECK(!a.isComplex());
 	}
+	SUBCASE("Numbers round to zero only below 1e-10") {
+		CHECK(Atom(0.25).asNumber() == 0.25);
+		CHECK(Atom(-1e-9).asNumber() == -1e-9);
+		CHECK(Atom(1e-12).asNumber() == 0);
+		CHECK(Atom(std::complex<double>(0.5, 1e-12)).isNumber());
+		CHECK(Atom(std::complex<double>(0, 0.5)).isComplex());
+	}
 	SUBCASE("Symbol constructor") {
 		Atom a("+/-");
 		CHECK(a.isSymbol());
@@ -67,6 +74,13 @@ TEST_CASE("Test atom comparisons") {
         CHECK(a != c);
     }
 
+    SUBCASE("compare close numbers")
+    {
+        CHECK(Atom(0.5) != Atom(0.0));
+        CHECK(Atom(0.1) != Atom(0.2));
+        CHECK(Atom(1.0) == Atom(1.0 + 1e-12));
+    }
+
     SUBCASE("compare number to symbol")
     {
         Atom a(1.0);
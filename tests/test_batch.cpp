@@ -0,0 +1,61 @@
+#include "doctest.h"
+#include <batch.h>
+
+TEST_CASE("Batch job splitting") {
+
+	std::string text =
+		"; header\n"
+		"(+ 1 2)\n"
+		"(begin\n"
+		"  (define s \"a)b\") ; not a ) close\n"
+		"  s)\n"
+		"bare )\n"
+		"(list 1";
+
+	auto jobs = batch::split(text);
+	REQUIRE(jobs.size() == 5);
+	CHECK(jobs[0].program == "(+ 1 2)");
+	CHECK(jobs[0].line == 2);
+	CHECK(jobs[1].program == "(begin\n  (define s \"a)b\") ; not a ) close\n  s)");
+	CHECK(jobs[1].line == 3);
+	CHECK(jobs[2].program == "bare");
+	CHECK(jobs[3].program == ")");
+	CHECK(jobs[3].line == 6);
+	CHECK(jobs[4].program == "(list 1");
+	CHECK(jobs[4].line == 7);
+
+	CHECK(batch::split("  ; nothing\n\n").empty());
+}
+
+TEST_CASE("Batch jobs run in isolation and report in order") {
+
+	std::vector<batch::Job> jobs;
+	for (int i = 0; i < 100; i++)
+		jobs.push_back({ "(+ " + std::to_string(i) + " 1)", 1 });
+	jobs.push_back({ "(define a 1)", 1 });
+	jobs.push_back({ "(a)", 1 });
+	jobs.push_back({ "(sqrt 1 2)", 1 });
+	jobs.push_back({ "(+ 40 2)", 1 });
+
+	Interpreter interp(1);
+	std::vector<batch::Outcome> outcomes;
+	std::vector<std::size_t> order;
+	batch::run(jobs, interp, 4, [&](std::size_t i, const batch::Outcome& outcome) {
+		order.push_back(i);
+		outcomes.push_back(outcome);
+	});
+
+	REQUIRE(outcomes.size() == jobs.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		CHECK(order[i] == i);
+	for (int i = 0; i < 100; i++)
+		CHECK(outcomes[i].text == "(" + std::to_string(i + 1) + ")");
+
+	CHECK(outcomes[100].ok);
+	CHECK(!outcomes[101].ok);
+	CHECK(outcomes[101].text == "Unknown symbol: a");
+	CHECK(!outcomes[102].ok);
+	CHECK(outcomes[102].text == "Error: in call to sqrt: invalid number of arguments.");
+	CHECK(outcomes[103].ok);
+	CHECK(outcomes[103].text == "(42)");
+}
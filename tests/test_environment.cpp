@@ -37,3 +37,49 @@ TEST_CASE("Environment default state") {
 		CHECK(env.is_known(sym));
 	}
 }
+
+TEST_CASE("Builtin table") {
+
+	for (const auto& builtin : builtins::all())
+		CHECK(builtins::find(builtin.name) == &builtin);
+
+	CHECK(builtins::find("op") == nullptr);
+	CHECK(builtins::find("") == nullptr);
+
+	const builtins::Builtin* sin = builtins::find("sin");
+	REQUIRE(sin != nullptr);
+	CHECK(sin->pure);
+	CHECK(sin->min_args == 1);
+	CHECK(sin->max_args == 1);
+	CHECK(!builtins::find("read-csv")->pure);
+
+	std::vector<Expression> number{ Expression(1.0) };
+	CHECK(builtins::find("map")->special);
+
+	// the common arities have direct entry points next to the span form
+	CHECK(sin->unary != nullptr);
+	CHECK(builtins::find("+")->binary != nullptr);
+	CHECK(builtins::find("list")->unary == nullptr);
+
+	SUBCASE("validation") {
+		std::vector<Expression> string{ Expression(Atom("\"a\"")) };
+		CHECK(!builtins::validate(*sin, number));
+
+		auto error = builtins::validate(*sin, {});
+		REQUIRE(error);
+		CHECK(error->message() == "Error: in call to sin: invalid number of arguments.");
+
+		error = builtins::validate(*sin, string);
+		REQUIRE(error);
+		CHECK(error->message() == "Error: in call to sin: argument 1 was not a number.");
+	}
+
+	SUBCASE("entry points agree") {
+		Environment env;
+		std::vector<Expression> pair{ Expression(3.0), Expression(4.0) };
+		CHECK(builtins::find("-")->binary(pair[0], pair[1]).value() == Expression(-1.0));
+		CHECK(builtins::find("-")->proc(pair).value() == Expression(-1.0));
+		CHECK(Expression::call(Atom("-"), Arguments(pair.data(), 1), env).value() == Expression(-3.0));
+		CHECK(sin->proc(number).value() == sin->unary(number[0]).value());
+	}
+}
@@ -28,4 +28,54 @@ TEST_CASE("Expression constructors") {
 		Expression plus(a);
 		CHECK(plus.head() == Atom("+"));
 	}
-}
\ No newline at end of file
+}
+TEST_CASE("Expression evaluate reports errors as values") {
+
+	Environment env;
+
+	Expression bad(Atom("sqrt"), { Expression(Atom(1.0)), Expression(Atom(2.0)) });
+	Result result = bad.evaluate(env);
+	CHECK(!result);
+	CHECK_EQ(result.error().message(), "Error: in call to sqrt: invalid number of arguments.");
+	CHECK_THROWS_AS(bad.eval(env), SemanticError);
+
+	Expression good(Atom("sqrt"), { Expression(Atom(4.0)) });
+	result = good.evaluate(env);
+	REQUIRE(result);
+	CHECK(*result == Expression(Atom(2.0)));
+}
+
+TEST_CASE("Expression children are shared until changed") {
+
+	Expression call(Atom("+"));
+	for (int i = 0; i < 10; i++)
+		call.append(Atom(static_cast<double>(i)));
+	CHECK_EQ(call.tailConstEnd() - call.tailConstBegin(), 10);
+	CHECK_EQ(call.tail()->head().asNumber(), 9);
+
+	Expression copy = call;
+	CHECK_EQ(copy.tailConstBegin(), call.tailConstBegin());
+
+	copy.append(Atom(10.0));
+	copy.tail()->setHead(Atom(-1.0));
+	CHECK_NE(copy.tailConstBegin(), call.tailConstBegin());
+	CHECK_EQ(call.tailConstEnd() - call.tailConstBegin(), 10);
+	CHECK_EQ(call.tail()->head().asNumber(), 9);
+	CHECK_EQ(copy.tail()->head().asNumber(), -1);
+
+	Environment env;
+	CHECK_EQ(call.eval(env), Expression(Atom(45.0)));
+
+	SUBCASE("properties belong to the copy they were set on") {
+		Expression point(Atom("list"), { Expression(Atom(0.0)), Expression(Atom(1.0)) });
+		CHECK(point.findProperty("size") == nullptr);
+
+		point.setProperty("size", Expression(Atom(2.0)));
+		Expression moved = point;
+		moved.setProperty("size", Expression(Atom(3.0)));
+
+		CHECK_EQ(point.getProperty("size"), Expression(Atom(2.0)));
+		CHECK_EQ(moved.getProperty("size"), Expression(Atom(3.0)));
+		CHECK_EQ(moved.getProperty("missing"), Expression());
+	}
+}
@@ -14,4 +14,228 @@ TEST_CASE("Interpreter tests") {
 		CHECK(in.parseStream(stream));
 	}
 		
-}
\ No newline at end of file
+}
+TEST_CASE("Forked interpreters") {
+
+	Interpreter parent(1);
+	auto run = [](Interpreter& interp, std::string text) {
+		REQUIRE(interp.interpret(text));
+		return interp.evaluate().toString();
+	};
+
+	run(parent, "(define data (range 0 9))");
+	run(parent, "(define scale (lambda (x) (* 10 x)))");
+
+	Interpreter child = parent.fork();
+
+	SUBCASE("children see the parent's definitions") {
+		CHECK_EQ(run(child, "(sum data)"), "(45)");
+		CHECK_EQ(run(child, "(scale 2)"), "(20)");
+	}
+
+	SUBCASE("definitions after the fork stay in their session") {
+		run(child, "(define data 5)");
+		run(child, "(define only-child 1)");
+		run(parent, "(define only-parent 2)");
+
+		CHECK_EQ(run(child, "(data)"), "(5)");
+		CHECK_EQ(run(parent, "(length data)"), "(10)");
+		CHECK_THROWS(run(parent, "(only-child)"));
+		CHECK_THROWS(run(child, "(only-parent)"));
+
+		Interpreter grandchild = child.fork();
+		CHECK_EQ(run(grandchild, "(+ data only-child)"), "(6)");
+	}
+
+	SUBCASE("builtins cannot be shadowed in a fork") {
+		CHECK_THROWS(run(child, "(define sin 1)"));
+	}
+
+	SUBCASE("forking after every definition keeps lookups shallow") {
+		for (int i = 0; i < 256; i++) {
+			run(parent, "(define v" + std::to_string(i) + " " + std::to_string(i) + ")");
+			(void)parent.fork();
+		}
+		run(parent, "(define v0 -1)");
+		(void)parent.fork();
+
+		parent.reset_stats();
+		CHECK_EQ(run(parent, "(+ v0 v255 (length data))"), "(264)");
+		CHECK_LT(parent.stats()[stats::MapFinds], 64u);
+	}
+}
+
+TEST_CASE("Evaluation budgets") {
+
+	Interpreter interp(1);
+	auto message = [&](const std::string& program) {
+		Result result = interp.run_isolated(program);
+		return result ? std::string() : result.error().message();
+	};
+	auto reason = [&](const std::string& program) {
+		Result result = interp.run_isolated(program);
+		return result ? Stop::None : result.error().stop();
+	};
+
+	SUBCASE("unlimited by default") {
+		CHECK(interp.run_isolated("(sum (range 0 100000))"));
+		CHECK_FALSE(interp.interrupt());
+	}
+
+	SUBCASE("fuel stops a long evaluation") {
+		interp.set_limits({ 1000, {}, 0 });
+		CHECK(interp.run_isolated("(+ 1 2)"));
+		CHECK_NE(message("(sum (range 0 100000))").find("ran out of fuel"), std::string::npos);
+
+		Interpreter child = interp.fork();
+		CHECK_EQ(child.limits().fuel, 1000u);
+		CHECK_NE(message("(begin (define f (lambda (x) (* x x))) (map f (range 0 10000)))").find("ran out of fuel"),
+			std::string::npos);
+	}
+
+	SUBCASE("a stop is told apart from an error in the program and is not wrapped") {
+		CHECK(reason("(sin \"x\")") == Stop::None);
+
+		interp.set_limits({ 7, {}, 0 });
+		std::string program = "(begin (define f (lambda (x) (+ x 1))) (apply f (list 1)))";
+		CHECK(reason(program) == Stop::Fuel);
+		CHECK_EQ(message(program), "Error: evaluation ran out of fuel after 7 steps");
+
+		std::istringstream text("(sum (range 0 100000))");
+		REQUIRE(interp.parseStream(text));
+		try {
+			interp.evaluate();
+			CHECK(false);
+		}
+		catch (const EvaluationStopped& stopped) {
+			CHECK(stopped.reason == Stop::Fuel);
+		}
+	}
+
+	SUBCASE("allocations over the limit fail before they are made") {
+		interp.set_limits({ 0, {}, 1 << 20 });
+		CHECK(interp.run_isolated("(range 0 1000)"));
+		CHECK_NE(message("(range 0 1e12)").find("exceeds the limit"), std::string::npos);
+		CHECK(reason("(range 0 1e12)") == Stop::Allocation);
+	}
+
+	SUBCASE("deadline") {
+		interp.set_limits({ 0, std::chrono::milliseconds(1), 0 });
+		CHECK_NE(message("(begin (define f (lambda (x) (* x x))) (map f (range 0 1000000)))").find("deadline"),
+			std::string::npos);
+		CHECK(reason("(begin (define f (lambda (x) (* x x))) (map f (range 0 1000000)))") == Stop::Deadline);
+	}
+}
+
+TEST_CASE("Memory accounting") {
+
+	Interpreter interp(1);
+	auto run = [&](const std::string& program) {
+		std::string text = program;
+		REQUIRE(interp.interpret(text));
+		return interp.try_evaluate();
+	};
+
+	MemoryUsage start = interp.memory();
+
+	REQUIRE(run("(define big (range 0 99999))"));
+	CHECK_GE(interp.last_form_memory().retained, 800000);
+	CHECK_GE(interp.memory().current, start.current + 800000);
+
+	SUBCASE("temporaries count toward the peak but are not retained") {
+		REQUIRE(run("(length (range 0 99999))"));
+		CHECK_GE(interp.last_form_memory().peak, 800000u);
+		CHECK_LT(interp.last_form_memory().retained, 800000);
+
+		REQUIRE(run("(define big 0)"));
+		CHECK_LE(interp.last_form_memory().retained, -800000);
+	}
+
+	SUBCASE("only the interpreter's own data is charged") {
+		auto account = MemoryAccount::open();
+		{
+			MemoryAccount::Scope charging(account.get());
+			std::vector<char> unrelated(1 << 20);
+			CHECK_EQ(account->usage().current, 0u);
+
+			Expression list(Atom("list"), std::vector<Expression>(100, Expression(Atom(1.0))));
+			CHECK_GE(account->usage().current, 100 * sizeof(Expression));
+		}
+		CHECK_EQ(account->usage().current, 0u);
+	}
+
+	SUBCASE("a fork is charged for its own definitions only") {
+		Interpreter child = interp.fork();
+		std::size_t parent = interp.memory().current;
+		CHECK_LT(child.memory().current, 800000u);
+
+		REQUIRE(child.run_isolated("(length big)"));
+		std::istringstream program("(define mine (range 0 99999))");
+		REQUIRE(child.parseStream(program));
+		REQUIRE(child.try_evaluate());
+		CHECK_GE(child.memory().current, 800000u);
+		CHECK_EQ(interp.memory().current, parent);
+	}
+
+	SUBCASE("the limit stops an evaluation and leaves the interpreter usable") {
+		Limits limits;
+		limits.max_memory = interp.memory().current + 400000;
+		interp.set_limits(limits);
+
+		Result result = run("(range 0 99999)");
+		REQUIRE_FALSE(result);
+		CHECK_NE(result.error().message().find("memory limit"), std::string::npos);
+
+		CHECK(run("(+ 1 2)"));
+		CHECK(interp.run_isolated("(length (range 0 9999))"));
+	}
+}
+
+TEST_CASE("Runtime stats") {
+
+	Interpreter interp(1);
+	auto run = [&](const std::string& program) {
+		std::string text = program;
+		REQUIRE(interp.interpret(text));
+		return interp.try_evaluate();
+	};
+
+	REQUIRE(run("(define f (lambda (x) (* x x)))"));
+	interp.reset_stats();
+	REQUIRE(run("(map f (range 1 100))"));
+
+	stats::Snapshot counts = interp.stats();
+	CHECK_EQ(counts[stats::LambdaCalls], 100u);
+	CHECK_GE(counts[stats::BuiltinCalls], 100u);
+	CHECK_GE(counts[stats::Lookups], 100u);
+	CHECK_GE(counts[stats::MapFinds], counts[stats::Lookups] / 2);
+	CHECK_GT(counts[stats::BytesAllocated], 0u);
+
+	// a packed list such as range's has no children to count
+	REQUIRE(run("(list 1 2 3 4 5 6 7)"));
+	CHECK_GE(interp.stats()[stats::LongestTail], 7u);
+
+	SUBCASE("the builtins read the same counters and reset them") {
+		Result before = run("(reset-runtime-stats)");
+		REQUIRE(before);
+		CHECK_EQ(before->getProperty("\"lambda-calls\"").head().asNumber(), 100);
+
+		Result after = run("(get-property \"lambda-calls\" (runtime-stats))");
+		REQUIRE(after);
+		CHECK_EQ(after->head().asNumber(), 0);
+		CHECK_EQ(run("(length (runtime-stats))")->head().asNumber(), static_cast<double>(stats::COUNT));
+	}
+
+	SUBCASE("only an explicit call runs them") {
+		Result listed = run("(list runtime-stats)");
+		REQUIRE_FALSE(listed);
+		CHECK_EQ(listed.error().message(), "Unknown symbol: runtime-stats");
+		CHECK_FALSE(run("(begin (define counts runtime-stats) 0)"));
+
+		Result called = run("(list (runtime-stats))");
+		REQUIRE(called);
+		const Expression* calls = called->tailConstBegin()->findProperty("\"lambda-calls\"");
+		REQUIRE(calls != nullptr);
+		CHECK_EQ(calls->head().asNumber(), 100);
+	}
+}
@@ -0,0 +1,74 @@
+#include "doctest.h"
+#include <interpreter.h>
+#include <packed.h>
+
+std::string run(Interpreter& interp, std::string program) {
+	REQUIRE(interp.interpret(program));
+	return interp.evaluate().toString();
+}
+
+TEST_CASE("Packed numeric lists") {
+
+	Interpreter interp;
+
+	SUBCASE("range and literals are packed") {
+		std::string program("(range 0 3)");
+		REQUIRE(interp.interpret(program));
+		Expression result = interp.evaluate();
+		REQUIRE(result.packed() != nullptr);
+		CHECK(result.packed()->size() == 4);
+		CHECK_EQ(result.toString(), "((0) (1) (2) (3))");
+
+		std::string literal("(list 1 I 3)");
+		REQUIRE(interp.interpret(literal));
+		result = interp.evaluate();
+		REQUIRE(result.packed() != nullptr);
+		CHECK(result.packed()->isComplex());
+		CHECK_EQ(result.toString(), "((1) (0, 1) (3))");
+	}
+
+	SUBCASE("mixed lists stay generic") {
+		std::string program("(list 1 \"a\")");
+		REQUIRE(interp.interpret(program));
+		CHECK(interp.evaluate().packed() == nullptr);
+	}
+
+	SUBCASE("list builtins") {
+		CHECK_EQ(run(interp, "(first (range 3 6))"), "(3)");
+		CHECK_EQ(run(interp, "(rest (list 1 I 3))"), "((0, 1) (3))");
+		CHECK_EQ(run(interp, "(length (range 0 9))"), "(10)");
+		CHECK_EQ(run(interp, "(range 3 3)"), "((3))");
+		CHECK_EQ(run(interp, "(range 3 3 0.5)"), "((3))");
+		CHECK_EQ(run(interp, "(append (range 0 2) I)"), "((0) (1) (2) (0, 1))");
+		CHECK_EQ(run(interp, "(append (range 0 1) \"a\")"), "((0) (1) (\"a\"))");
+		CHECK_EQ(run(interp, "(join (range 0 1) (list 5 I))"), "((0) (1) (5) (0, 1))");
+	}
+
+	SUBCASE("walking a packed list does not expand it") {
+		// expanded, 100000 items would take over 10 MB of Expressions
+		CHECK_EQ(run(interp, "(length (rest (range 0 99999)))"), "(99999)");
+		CHECK_LT(interp.last_form_memory().peak, 4000000u);
+		run(interp, "(define inc (lambda (x) (+ x 1)))");
+		run(interp, "(define sq (lambda (x) (* x x)))");
+		CHECK_EQ(run(interp, "(length (map inc (range 0 99999)))"), "(100000)");
+		CHECK_LT(interp.last_form_memory().peak, 16000000u);
+
+		CHECK_EQ(run(interp, "(map sq (range 1 3))"), "((1) (4) (9))");
+		CHECK_EQ(run(interp, "(pmap sq (range 1 3))"), "((1) (4) (9))");
+		CHECK_EQ(run(interp, "(apply + (range 1 4))"), "(10)");
+		CHECK_EQ(run(interp, "(rest (range 1 1))"), "()");
+
+		std::string empty("(first (rest (list 7)))");
+		REQUIRE(interp.interpret(empty));
+		CHECK_FALSE(interp.try_evaluate());
+	}
+
+	SUBCASE("packed and generic lists compare equal") {
+		std::vector<Expression> items{ Expression(Atom(1.0)), Expression(Atom(2.0)) };
+		Expression generic(Atom("list"), items);
+		Expression packed(NumericVector::pack(items));
+
+		CHECK(generic == packed);
+		CHECK(packed == generic);
+	}
+}
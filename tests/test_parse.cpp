@@ -1,5 +1,9 @@
 #include "doctest.h"
 #include <parse.h>
+#include <prelude.h>
+#include <prelude_data.h>
+
+#include <fstream>
 
 TEST_CASE("Parser") {
 
@@ -75,4 +79,47 @@ TEST_CASE("Parser") {
 		Expression out = parse(tokens);
 		CHECK_EQ(out, Expression(Atom("\"Hello World!\"")));
 	}
-}
\ No newline at end of file
+}
+namespace {
+	// Expression's operator== ignores the empty-call mark, so walk the trees.
+	bool same_tree(const Expression& a, const Expression& b) {
+		if (!(a.head() == b.head()) || a.isEmptyCall() != b.isEmptyCall())
+			return false;
+		if (a.tailConstEnd() - a.tailConstBegin() != b.tailConstEnd() - b.tailConstBegin())
+			return false;
+		for (auto x = a.tailConstBegin(), y = b.tailConstBegin(); x != a.tailConstEnd(); x++, y++)
+			if (!same_tree(*x, *y))
+				return false;
+		return true;
+	}
+}
+
+TEST_CASE("Prelude tables rebuild the parsed program") {
+
+	SUBCASE("the generated prelude matches startup.script") {
+		std::ifstream script(STARTUP_FILE);
+		REQUIRE(script);
+		Expression parsed = parse(tokenize(script));
+		REQUIRE_FALSE(parsed == Expression());
+
+		CHECK(same_tree(build_prelude(PRELUDE, std::size(PRELUDE)), parsed));
+	}
+
+	SUBCASE("an empty call keeps its mark") {
+		// the table prelude_gen writes for the program below
+		constexpr PreludeNode table[] = {
+			{ PreludeNode::Symbol, "list", 0, 3, false },
+			{ PreludeNode::Symbol, "f", 0, 0, true },
+			{ PreludeNode::Symbol, "f", 0, 0, false },
+			{ PreludeNode::Number, nullptr, 2.5, 0, false },
+		};
+		std::istringstream program("(list (f) f 2.5)");
+		Expression parsed = parse(tokenize(program));
+		REQUIRE(parsed.tailConstBegin()->isEmptyCall());
+
+		Expression rebuilt = build_prelude(table, std::size(table));
+		CHECK(rebuilt.tailConstBegin()->isEmptyCall());
+		CHECK_FALSE((rebuilt.tailConstBegin() + 1)->isEmptyCall());
+		CHECK(same_tree(rebuilt, parsed));
+	}
+}
@@ -0,0 +1,55 @@
+#include "doctest.h"
+#include <interpreter.h>
+#include <profiler.h>
+
+#include <algorithm>
+#include <sstream>
+
+TEST_CASE("Profiler") {
+
+	auto calls = [](const profiler::Profile& profile, const std::string& name) -> std::uint64_t {
+		auto it = std::find_if(profile.procedures.begin(), profile.procedures.end(),
+			[&](const profiler::Procedure& p) { return p.name == name; });
+		return it == profile.procedures.end() ? 0 : it->calls;
+	};
+
+	std::string program = "(begin (define f (lambda (x) (* x x))) (pmap f (range 0 199)))";
+	Interpreter interp(2);
+
+	if (!profiler::start()) {
+		MESSAGE("no profiling timer on this platform");
+		return;
+	}
+	REQUIRE(interp.run_isolated(program));
+	profiler::stop();
+
+	profiler::Profile profile = profiler::collect();
+	CHECK_EQ(calls(profile, "pmap"), 1u);
+	CHECK_EQ(calls(profile, "f"), 200u);
+	CHECK_EQ(calls(profile, "*"), 200u);
+	CHECK_EQ(calls(profile, "range"), 1u);
+
+	// every sample is in exactly one folded stack
+	std::uint64_t folded = 0;
+	for (const auto& [stack, count] : profile.folded) {
+		CHECK(stack.find(' ') == std::string::npos);
+		folded += count;
+	}
+	CHECK_EQ(folded + profile.dropped, profile.samples);
+
+	std::ostringstream out;
+	profiler::write_folded(out, profile);
+	std::string text = out.str();
+	CHECK_EQ(std::count(text.begin(), text.end(), '\n'), static_cast<long>(profile.folded.size()));
+
+	SUBCASE("nothing is counted once stopped") {
+		REQUIRE(interp.run_isolated(program));
+		CHECK_EQ(calls(profiler::collect(), "f"), 200u);
+	}
+
+	SUBCASE("a new session starts from nothing") {
+		REQUIRE(profiler::start());
+		profiler::stop();
+		CHECK_EQ(calls(profiler::collect(), "f"), 0u);
+	}
+}
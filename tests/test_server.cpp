@@ -0,0 +1,118 @@
+#include "doctest.h"
+#include <server.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+TEST_CASE("Server wire format") {
+
+	std::string buffer;
+	wire::append_message(buffer, "(+ 1 2)");
+	wire::append_message(buffer, "");
+	CHECK(buffer.size() == 4 + 7 + 4);
+
+	std::size_t offset = 0;
+	std::string payload;
+	CHECK(wire::take_message(buffer, offset, payload) == wire::Take::Message);
+	CHECK(payload == "(+ 1 2)");
+	CHECK(wire::take_message(buffer, offset, payload) == wire::Take::Message);
+	CHECK(payload.empty());
+	CHECK(offset == buffer.size());
+	CHECK(wire::take_message(buffer, offset, payload) == wire::Take::Incomplete);
+
+	std::string partial;
+	wire::append_message(partial, "(list 1 2)");
+	partial.pop_back();
+	offset = 0;
+	CHECK(wire::take_message(partial, offset, payload) == wire::Take::Incomplete);
+	CHECK(offset == 0);
+
+	std::string huge("\xff\xff\xff\xff", 4);
+	CHECK(wire::take_message(huge, offset, payload) == wire::Take::TooLong);
+}
+
+TEST_CASE("Server evaluates pipelined requests in order") {
+
+	std::string path = "/tmp/plotscript_test_" + std::to_string(getpid()) + ".sock";
+	Server server(path, 2, 1);
+	std::thread serving([&] { server.run(); });
+
+	std::unique_ptr<Client> client;
+	for (int attempt = 0; attempt < 500 && !(client && client->is_open()); attempt++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		client = std::make_unique<Client>(path);
+	}
+	REQUIRE(client->is_open());
+
+	const int count = 200;
+	for (int i = 0; i < count; i++)
+		CHECK(client->send("(+ " + std::to_string(i) + " 1)"));
+	CHECK(client->send("(define a 1)"));
+	CHECK(client->send("(a)"));
+	CHECK(client->send("(sin \"x\")"));
+	CHECK(client->send("(+ 1"));
+
+	for (int i = 0; i < count; i++) {
+		auto response = client->receive();
+		REQUIRE(response);
+		CHECK(response->ok);
+		CHECK(response->text == "(" + std::to_string(i + 1) + ")");
+	}
+
+	auto defined = client->receive();
+	REQUIRE(defined);
+	CHECK(defined->ok);
+
+	// every request starts from a fresh session
+	auto lookup = client->receive();
+	REQUIRE(lookup);
+	CHECK(!lookup->ok);
+	CHECK(lookup->text == "Unknown symbol: a");
+
+	auto error = client->receive();
+	REQUIRE(error);
+	CHECK(!error->ok);
+	CHECK(error->text == "Error: in call to sin: argument 1 was not a number.");
+
+	auto unparsed = client->receive();
+	REQUIRE(unparsed);
+	CHECK(!unparsed->ok);
+	CHECK(unparsed->text == "Invalid Program. Could not parse.");
+
+	server.stop();
+	serving.join();
+	CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+TEST_CASE("Server answers requests whose responses outgrow its output limit") {
+
+	std::string path = "/tmp/plotscript_test_output_" + std::to_string(getpid()) + ".sock";
+	Server server(path, 2, 1);
+	std::thread serving([&] { server.run(); });
+
+	std::unique_ptr<Client> client;
+	for (int attempt = 0; attempt < 500 && !(client && client->is_open()); attempt++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		client = std::make_unique<Client>(path);
+	}
+	REQUIRE(client->is_open());
+
+	// about 6 MB of responses, sent before any is read, so the server has to
+	// stop reading and pick the remaining requests up as its output drains
+	const int count = 40;
+	for (int i = 0; i < count; i++)
+		CHECK(client->send("(range " + std::to_string(i) + " " + std::to_string(i + 20000) + ")"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	for (int i = 0; i < count; i++) {
+		auto response = client->receive();
+		REQUIRE(response);
+		CHECK(response->ok);
+		CHECK(response->text.compare(0, 4 + std::to_string(i).size(), "((" + std::to_string(i) + ") ") == 0);
+	}
+
+	server.stop();
+	serving.join();
+}
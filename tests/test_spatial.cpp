@@ -0,0 +1,110 @@
+#include "doctest.h"
+#include <graphics.h>
+#include <interpreter.h>
+#include <spatial.h>
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+	std::string evaluate(Interpreter& interp, std::string program) {
+		REQUIRE(interp.interpret(program));
+		return interp.evaluate().toString();
+	}
+
+	// Random points and short lines, so query results can be checked by a scan.
+	Expression scatter(std::size_t count) {
+		std::mt19937 random(7);
+		std::uniform_real_distribution<double> coordinate(-100, 100);
+		std::uniform_real_distribution<double> offset(-5, 5);
+
+		std::vector<Expression> objects;
+		for (std::size_t i = 0; i < count; i++) {
+			double x = coordinate(random), y = coordinate(random);
+			if (i % 3 == 0)
+				objects.push_back(make_line(make_point(x, y), make_point(x + offset(random), y + offset(random))));
+			else
+				objects.push_back(make_point(x, y));
+		}
+		return { Atom("list"), objects };
+	}
+}
+
+TEST_CASE("Spatial index") {
+
+	Interpreter interp(1);
+
+	SUBCASE("builtins") {
+		std::string setup = "(define idx (spatial-index (list (make-point 0 0) (make-point 5 5) "
+			"(make-line (make-point -1 3) (make-point 3 -1)) (make-point 10 10))))";
+		CHECK_EQ(evaluate(interp, setup), "(spatial-index of 4 objects)");
+		CHECK_EQ(evaluate(interp, "(query-rect idx 6 6 0.5 0.5)"), "(((5) (5)) (((-1) (3)) ((3) (-1))))");
+		CHECK_EQ(evaluate(interp, "(nearest idx 9 9 2)"), "(((10) (10)) ((5) (5)))");
+		CHECK_EQ(evaluate(interp, "(length (nearest idx 0 0 10))"), "(4)");
+	}
+
+	SUBCASE("errors") {
+		std::string program = "(spatial-index (list (make-text \"a\")))";
+		REQUIRE(interp.interpret(program));
+		CHECK_THROWS(interp.evaluate());
+
+		program = "(query-rect (list 1 2) 0 0 1 1)";
+		REQUIRE(interp.interpret(program));
+		CHECK_THROWS(interp.evaluate());
+	}
+
+	SUBCASE("queries match a linear scan") {
+		ThreadPool pool(3);
+		ThreadPool::Scope scope(&pool);
+
+		Expression objects = scatter(20000);
+		auto index = SpatialIndex::build(objects);
+		REQUIRE(index);
+
+		SpatialIndex::Box rect{ -20, 10, 15, 40 };
+		std::vector<Expression> expected;
+		for (auto it = objects.tailConstBegin(); it != objects.tailConstEnd(); it++) {
+			double x0, y0, x1, y1;
+			if (object_name(*it) == "point") {
+				point_coordinates(*it, x0, y0);
+				x1 = x0;
+				y1 = y0;
+			}
+			else {
+				point_coordinates(*it->tailConstBegin(), x0, y0);
+				point_coordinates(*(it->tailConstBegin() + 1), x1, y1);
+			}
+			// dense sampling is enough for lines a few units long
+			for (int s = 0; s <= 1000; s++) {
+				double x = x0 + (x1 - x0) * s / 1000, y = y0 + (y1 - y0) * s / 1000;
+				if (x >= rect.x0 && x <= rect.x1 && y >= rect.y0 && y <= rect.y1) {
+					expected.push_back(*it);
+					break;
+				}
+			}
+		}
+		std::vector<Expression> found = (*index)->query(rect);
+		CHECK(found.size() == expected.size());
+		CHECK(found == expected);
+
+		std::vector<std::pair<double, std::size_t>> points;
+		std::size_t i = 0;
+		for (auto it = objects.tailConstBegin(); it != objects.tailConstEnd(); it++, i++) {
+			double x, y;
+			if (point_coordinates(*it, x, y))
+				points.emplace_back(std::hypot(x - 3, y + 7), i);
+		}
+		std::sort(points.begin(), points.end());
+
+		std::vector<Expression> nearest = (*index)->nearest(3, -7, 50);
+		REQUIRE(nearest.size() == 50);
+		// every returned object is at least as close as the 50th nearest point
+		for (const auto& obj : nearest) {
+			double x, y;
+			if (point_coordinates(obj, x, y))
+				CHECK(std::hypot(x - 3, y + 7) <= points[49].first);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#include "doctest.h"
+#include <interpreter.h>
+#include <thread_pool.h>
+
+#include <filesystem>
+
+TEST_CASE("Thread pool parallel_for") {
+
+	ThreadPool pool(4);
+	CHECK(pool.size() == 4);
+
+	SUBCASE("every index visited once") {
+		std::vector<int> hits(1000, 0);
+		pool.parallel_for(hits.size(), [&](std::size_t i) { hits[i]++; });
+
+		for (int h : hits)
+			CHECK(h == 1);
+	}
+
+	SUBCASE("exceptions reach the caller") {
+		CHECK_THROWS_AS(pool.parallel_for(100, [](std::size_t i) {
+			if (i == 42)
+				throw std::runtime_error("boom");
+		}), std::runtime_error);
+	}
+
+#ifdef __linux__
+	SUBCASE("workers start with the first parallel work") {
+		auto threads = [] {
+			auto tasks = std::filesystem::directory_iterator("/proc/self/task");
+			return std::distance(std::filesystem::begin(tasks), std::filesystem::end(tasks));
+		};
+
+		auto before = threads();
+		ThreadPool idle(3);
+		CHECK(threads() == before);
+
+		idle.parallel_for(1, [](std::size_t) {});
+		CHECK(threads() == before);
+		idle.parallel_for(10, [](std::size_t) {});
+		CHECK(threads() == before + 3);
+	}
+#endif
+
+	SUBCASE("serial pool") {
+		ThreadPool serial(0);
+		int sum = 0;
+		serial.parallel_for(10, [&](std::size_t i) { sum += static_cast<int>(i); });
+		CHECK(sum == 45);
+	}
+}
+
+TEST_CASE("pmap is deterministic") {
+
+	std::string program("(begin (define f (lambda (x) (+ (* x x) 1))) (map f (range 0 500)))");
+	Interpreter serial(0);
+	CHECK(serial.interpret(program));
+	std::string expected = serial.evaluate().toString();
+
+	std::string parallel_program("(begin (define f (lambda (x) (+ (* x x) 1))) (pmap f (range 0 500)))");
+	Interpreter parallel(4);
+	for (int run = 0; run < 10; run++) {
+		CHECK(parallel.interpret(parallel_program));
+		CHECK_EQ(parallel.evaluate().toString(), expected);
+	}
+}
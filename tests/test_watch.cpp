@@ -0,0 +1,209 @@
+#include "doctest.h"
+#include <watch.h>
+
+#include <thread>
+
+TEST_CASE("Watch splits a begin script into its forms") {
+
+	std::string text =
+		"; settings\n"
+		"(begin\n"
+		"  (define a 1)\n"
+		"  (define b (+ a 1))\n"
+		"  b)\n";
+
+	auto forms = watch::split(text);
+	REQUIRE(forms.size() == 3);
+	CHECK(forms[0].program == "(define a 1)");
+	CHECK(forms[0].line == 3);
+	CHECK(forms[1].program == "(define b (+ a 1))");
+	CHECK(forms[1].line == 4);
+	CHECK(forms[2].program == "b");
+	CHECK(forms[2].line == 5);
+
+	CHECK(watch::split("(define a 1) (+ a 1)").size() == 2);
+	CHECK(watch::split("(beginning 1)").size() == 1);
+}
+
+TEST_CASE("Watch re-evaluates only what an edit can change") {
+
+	Interpreter interp(1);
+	watch::Session session(interp);
+
+	auto script = [](const std::string& a, const std::string& tail) {
+		std::string text = "(begin\n(define a " + a + ")\n(define b (+ a 1))\n";
+		for (int i = 0; i < 50; i++)
+			text += "(define c" + std::to_string(i) + " " + std::to_string(i) + ")\n";
+		return text + "(define f (lambda (x) (* x b)))\n" + tail + ")";
+	};
+
+	watch::Report report = session.update(script("1", "(f 10)"));
+	CHECK(report.forms == 54);
+	CHECK(report.evaluated == 54);
+	REQUIRE(report.result);
+	CHECK(report.result->head().asNumber() == 20);
+
+	SUBCASE("an unchanged script evaluates nothing") {
+		report = session.update(script("1", "(f 10)"));
+		CHECK(report.evaluated == 0);
+		REQUIRE(report.result);
+		CHECK(report.result->head().asNumber() == 20);
+	}
+
+	SUBCASE("a changed definition re-runs its dependents") {
+		report = session.update(script("2", "(f 10)"));
+		// a, b, f and the call
+		CHECK(report.evaluated == 4);
+		REQUIRE(report.result);
+		CHECK(report.result->head().asNumber() == 30);
+	}
+
+	SUBCASE("a new value equal to the old stops there") {
+		report = session.update(script("(- 2 1)", "(f 10)"));
+		CHECK(report.evaluated == 1);
+		CHECK(report.result->head().asNumber() == 20);
+	}
+
+	SUBCASE("an edited form sees the definitions it did not re-run") {
+		report = session.update(script("1", "(+ c49 (f 1))"));
+		CHECK(report.evaluated == 1);
+		REQUIRE(report.result);
+		CHECK(report.result->head().asNumber() == 51);
+	}
+
+	SUBCASE("removing a definition fails what used it") {
+		std::string text = script("1", "(f 10)");
+		text.erase(text.find("(define b (+ a 1))\n"), std::string("(define b (+ a 1))\n").size());
+		report = session.update(text);
+		CHECK(report.evaluated == 2);
+		REQUIRE(report.failures.size() == 1);
+		CHECK(report.failures[0].line == 54);
+		CHECK_FALSE(report.result);
+	}
+
+	SUBCASE("a parse error is reported and the rest still runs") {
+		report = session.update(script("(+ 1", "(f 10)"));
+		REQUIRE_FALSE(report.failures.empty());
+		CHECK(report.failures[0].line == 2);
+
+		report = session.update(script("1", "(f 10)"));
+		CHECK(report.failures.empty());
+		CHECK(report.result->head().asNumber() == 20);
+	}
+}
+
+TEST_CASE("Watch follows names defined more than once") {
+
+	Interpreter interp(1);
+	watch::Session session(interp);
+
+	auto script = [](const std::string& second) {
+		return "(define y 1)\n(define g (lambda (x) (+ x y)))\n(define y " + second + ")\n(g 0)";
+	};
+
+	REQUIRE(session.update(script("2")).result->head().asNumber() == 2);
+
+	// (g 0) mentions only g, but g's body reads the y defined after it
+	watch::Report report = session.update(script("5"));
+	REQUIRE(report.result);
+	CHECK(report.result->head().asNumber() == 5);
+
+	report = session.update("(define y 1)\n(define g (lambda (x) (+ x y)))\n(g 0)");
+	REQUIRE(report.result);
+	CHECK(report.result->head().asNumber() == 1);
+}
+
+TEST_CASE("Watch skips the forms before the first edit") {
+
+	Interpreter interp(1);
+	watch::Session session(interp);
+
+	auto script = [](const std::string& first, const std::string& last) {
+		std::string text = "(define a " + first + ")\n";
+		for (int i = 0; i < 1000; i++)
+			text += "(define c" + std::to_string(i) + " " + std::to_string(i) + ")\n";
+		return text + "(+ c999 " + last + ")\n";
+	};
+
+	watch::Report report = session.update(script("1", "1"));
+	CHECK(report.evaluated == 1002);
+	CHECK(report.replayed == 0);
+
+	report = session.update(script("1", "2"));
+	CHECK(report.evaluated == 1);
+	// at most the forms since the last snapshot are bound again
+	CHECK(report.replayed < 256);
+	REQUIRE(report.result);
+	CHECK(report.result->head().asNumber() == 1001);
+
+	report = session.update(script("2", "2"));
+	CHECK(report.evaluated == 1);
+	CHECK(report.replayed == 1001);
+	CHECK(report.result->head().asNumber() == 1001);
+
+	report = session.update(script("2", "c0"));
+	CHECK(report.evaluated == 1);
+	CHECK(report.result->head().asNumber() == 999);
+}
+
+TEST_CASE("Watch re-runs on edits that compare equal as values") {
+
+	Interpreter interp(1);
+	watch::Session session(interp);
+
+	SUBCASE("a changed property") {
+		auto script = [](const std::string& note) {
+			return "(begin\n(define a (set-property \"note\" \"" + note + "\" 5))\n(get-property \"note\" a))";
+		};
+		REQUIRE(session.update(script("v1")).result);
+
+		watch::Report report = session.update(script("v2"));
+		CHECK(report.evaluated == 2);
+		REQUIRE(report.result);
+		CHECK(report.result->head().asSymbol() == "\"v2\"");
+	}
+
+	SUBCASE("a change smaller than the tolerance of ==") {
+		// literals below 1e-10 read as zero, so the edit is to a number near 1
+		auto script = [](const std::string& x) {
+			return "(begin\n(define x " + x + ")\n(- (* x 1e12) 1e12))";
+		};
+		REQUIRE(session.update(script("1")).result);
+
+		watch::Report report = session.update(script("1.00000000001"));
+		CHECK(report.evaluated == 2);
+		REQUIRE(report.result);
+		CHECK(std::abs(report.result->head().asNumber() - 10) < 1e-3);
+	}
+}
+
+TEST_CASE("Watch stops an update when interrupted") {
+
+	Interpreter interp(1);
+	watch::Session session(interp);
+	CHECK_FALSE(session.interrupt());
+
+	std::string text = "(begin\n(define f (lambda (x) (sum (range 0 100))))\n"
+		"(define slow (map f (range 0 1000000)))\n(+ 1 2))";
+	auto interrupted = [&] {
+		std::thread stopper([&] {
+			while (!session.interrupt())
+				std::this_thread::yield();
+		});
+		watch::Report report = session.update(text);
+		stopper.join();
+		return report;
+	};
+
+	watch::Report report = interrupted();
+	REQUIRE_FALSE(report.result);
+	CHECK(report.result.error().stop() == Stop::Cancelled);
+	REQUIRE(report.failures.size() == 1);
+	CHECK(report.failures[0].line == 3);
+	CHECK_FALSE(session.interrupt());
+
+	// the stopped form and the one after it were not kept
+	report = interrupted();
+	CHECK(report.replayed == 1);
+	CHECK(report.evaluated == 1);
+}
@@ -1,5 +1,9 @@
 #include "doctest.h"
 #include <interpreter.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
 
 TEST_CASE("Math functions") {
 
@@ -27,4 +31,241 @@ TEST_CASE("Math functions") {
 		CHECK(calc.parseStream(text));
 		CHECK_EQ(calc.evaluate().toString(), "(2)");
 	}
-}
\ No newline at end of file
+
+	SUBCASE("Real and complex operands") {
+		std::istringstream product("(* 2 3 4)");
+		CHECK(calc.parseStream(product));
+		CHECK_EQ(calc.evaluate().toString(), "(24)");
+
+		std::istringstream imaginary("(* I I)");
+		CHECK(calc.parseStream(imaginary));
+		CHECK_EQ(calc.evaluate().toString(), "(-1)");
+
+		std::istringstream root("(sqrt -16)");
+		CHECK(calc.parseStream(root));
+		CHECK_EQ(calc.evaluate().toString(), "(0, 4)");
+
+		std::istringstream power("(^ -2 3)");
+		CHECK(calc.parseStream(power));
+		CHECK_EQ(calc.evaluate().toString(), "(-8)");
+
+		std::istringstream zero("(/ 0 0)");
+		CHECK(calc.parseStream(zero));
+		CHECK_THROWS_AS(calc.evaluate(), SemanticError);
+	}
+}
+TEST_CASE("List arithmetic") {
+
+	Interpreter calc;
+
+	SUBCASE("Map builtin over numbers") {
+		std::istringstream text("(map sqrt (list 4 16 9))");
+		CHECK(calc.parseStream(text));
+		CHECK_EQ(calc.evaluate().toString(), "((2) (4) (3))");
+
+		std::istringstream negative("(map sqrt (list -4 4))");
+		CHECK(calc.parseStream(negative));
+		CHECK_EQ(calc.evaluate().toString(), "((0, 2) (2))");
+	}
+
+	SUBCASE("Element-wise operators") {
+		std::istringstream text("(+ (list 1 2 3) (list 10 20 30))");
+		CHECK(calc.parseStream(text));
+		CHECK_EQ(calc.evaluate().toString(), "((11) (22) (33))");
+
+		std::istringstream mixed("(* (list 1 I) (list 2 3))");
+		CHECK(calc.parseStream(mixed));
+		CHECK_EQ(calc.evaluate().toString(), "((2) (0, 3))");
+
+		std::istringstream uneven("(- (list 1 2) (list 1))");
+		CHECK(calc.parseStream(uneven));
+		CHECK_THROWS_AS(calc.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("Reductions") {
+
+	Interpreter calc;
+
+	SUBCASE("Numeric builtins") {
+		std::istringstream sum("(sum (range 1 100))");
+		CHECK(calc.parseStream(sum));
+		CHECK_EQ(calc.evaluate().toString(), "(5050)");
+
+		std::istringstream complex("(sum (list 1 I 2))");
+		CHECK(calc.parseStream(complex));
+		CHECK_EQ(calc.evaluate().toString(), "(3, 1)");
+
+		std::istringstream product("(product (list 1 2 3 4))");
+		CHECK(calc.parseStream(product));
+		CHECK_EQ(calc.evaluate().toString(), "(24)");
+
+		std::istringstream extremes("(list (min (list 3 -2 7)) (max (list 3 -2 7)) (mean (range 0 10)))");
+		CHECK(calc.parseStream(extremes));
+		CHECK_EQ(calc.evaluate().toString(), "((-2) (7) (5))");
+
+		std::istringstream unordered("(min (list 1 I))");
+		CHECK(calc.parseStream(unordered));
+		CHECK_THROWS_AS(calc.evaluate(), SemanticError);
+	}
+
+	SUBCASE("Large lists are reduced in parallel") {
+		Interpreter parallel(4);
+		std::istringstream sum("(sum (range 0 200000))");
+		CHECK(parallel.parseStream(sum));
+		CHECK_EQ(parallel.evaluate().toString(), "(2.00001e+10)");
+	}
+
+	SUBCASE("Fold and reduce") {
+		std::istringstream fold("(begin (define f (lambda (a b) (+ a (* b b)))) (fold f 0 (range 1 3)))");
+		CHECK(calc.parseStream(fold));
+		CHECK_EQ(calc.evaluate().toString(), "(14)");
+
+		std::istringstream reduce("(reduce + (range 1 4))");
+		CHECK(calc.parseStream(reduce));
+		CHECK_EQ(calc.evaluate().toString(), "(10)");
+	}
+}
+
+TEST_CASE("Continuous plot") {
+
+	Interpreter plot(2);
+
+	SUBCASE("Straight lines are not subdivided") {
+		std::istringstream text("(begin (define f (lambda (x) (* 2 x))) (length (continuous-plot f (list 0 10))))");
+		CHECK(plot.parseStream(text));
+		CHECK_EQ(plot.evaluate().toString(), "(50)");
+	}
+
+	SUBCASE("Curves are refined where they bend") {
+		std::istringstream text("(length (continuous-plot sin (list -10 10)))");
+		CHECK(plot.parseStream(text));
+		CHECK(plot.evaluate().head().asNumber() > 50);
+	}
+
+	SUBCASE("Segments are line objects") {
+		std::istringstream text("(get-property \"object-name\" (first (continuous-plot sin (list 0 1))))");
+		CHECK(plot.parseStream(text));
+		CHECK_EQ(plot.evaluate().toString(), "(\"line\")");
+	}
+
+	SUBCASE("Bounds must be increasing") {
+		std::istringstream empty("(continuous-plot sin (list 0 0))");
+		CHECK(plot.parseStream(empty));
+		CHECK_THROWS_WITH(plot.evaluate(), "Error: second argument to continuous-plot does not have its lower bound below its upper bound");
+
+		std::istringstream reversed("(continuous-plot sin (list 1 -1))");
+		CHECK(plot.parseStream(reversed));
+		CHECK_THROWS_AS(plot.evaluate(), SemanticError);
+	}
+}
+
+TEST_CASE("Graphics constructors") {
+
+	Interpreter graphics(1);
+	auto run = [&](const std::string& program) {
+		std::istringstream text(program);
+		CHECK(graphics.parseStream(text));
+		return graphics.evaluate().toString();
+	};
+
+	CHECK_EQ(run("(make-point 1 2)"), "((1) (2))");
+	CHECK_EQ(run("(get-property \"size\" (make-point 1 2))"), "(1)");
+	CHECK_EQ(run("(make-line (make-point 0 0) (make-point 1 1))"), "(((0) (0)) ((1) (1)))");
+	CHECK_EQ(run("(get-property \"thickness\" (make-line 1 2))"), "(1)");
+	CHECK_EQ(run("(make-text \"hello\")"), "((\"hello\"))");
+	CHECK_EQ(run("(get-property \"position\" (make-text \"hello\"))"), "((0) (0))");
+	CHECK_EQ(run("(get-property \"text-rotation\" (make-text \"hello\"))"), "(0)");
+	CHECK_EQ(run("(get-property \"object-name\" (make-text \"hello\"))"), "(\"text\")");
+}
+
+TEST_CASE("Decimation") {
+
+	Interpreter plot(2);
+	auto run = [&](const std::string& program) {
+		std::istringstream text(program);
+		CHECK(plot.parseStream(text));
+		return plot.evaluate().toString();
+	};
+
+	SUBCASE("Largest triangle three buckets keeps the peaks") {
+		CHECK_EQ(run("(decimate-lttb (list (list 0 0) (list 1 5) (list 2 1) (list 3 1) (list 4 -4) (list 5 0) (list 6 0)) 4)"),
+			"(((0) (0)) ((1) (5)) ((4) (-4)) ((6) (0)))");
+	}
+
+	SUBCASE("Min-max keeps both extremes of each bucket") {
+		CHECK_EQ(run("(decimate-min-max (list (make-point 0 0) (make-point 1 5) (make-point 2 1) (make-point 3 1) (make-point 4 -4) (make-point 5 0)) 4)"),
+			"(((0) (0)) ((1) (5)) ((3) (1)) ((4) (-4)))");
+		CHECK_EQ(run("(get-property \"object-name\" (first (decimate-min-max (list (make-point 0 0) (make-point 1 1) (make-point 2 2)) 2)))"),
+			"(\"point\")");
+	}
+
+	SUBCASE("Parallel variants agree on large inputs") {
+		run("(define f (lambda (x) (list x (sin x))))");
+		run("(define points (map f (range 0 2000 0.01)))");
+		CHECK_EQ(run("(pdecimate-min-max points 4000)"), run("(decimate-min-max points 4000)"));
+		CHECK_EQ(run("(length (pdecimate-lttb points 4000))"), "(4000)");
+	}
+
+	SUBCASE("Short series are returned unchanged") {
+		CHECK_EQ(run("(length (decimate-lttb (list (list 0 0) (list 1 1)) 10))"), "(2)");
+	}
+}
+
+TEST_CASE("Reading CSV") {
+
+	Interpreter data(2);
+	auto run = [&](const std::string& program) {
+		std::istringstream text(program);
+		CHECK(data.parseStream(text));
+		return data.evaluate().toString();
+	};
+
+	std::string path = "read_csv_test.csv";
+	{
+		std::ofstream out(path);
+		out << "x,y\n1,2\n3, 4.5\n\n-1e3,+7\r\n";
+	}
+	CHECK_EQ(run("(read-csv \"" + path + "\")"), "(((1) (3) (-1000)) ((2) (4.5) (7)))");
+	CHECK_EQ(run("(first (read-csv-points \"" + path + "\"))"), "((1) (2))");
+
+	{
+		std::ofstream out(path);
+		for (int i = 0; i < 200000; i++)
+			out << i << "\t" << 2 * i << "\n";
+	}
+	CHECK_EQ(run("(sum (first (rest (read-csv \"" + path + "\"))))"), "(3.99998e+10)");
+
+	{
+		std::ofstream out(path);
+		out << "1,2\n3\n";
+	}
+	std::istringstream ragged("(read-csv \"" + path + "\")");
+	CHECK(data.parseStream(ragged));
+	CHECK_THROWS_WITH(data.evaluate(), "Error: line 2 of read_csv_test.csv does not have 2 numeric fields");
+	std::remove(path.c_str());
+}
+
+TEST_CASE("SVG export") {
+
+	Interpreter plot(1);
+	std::string path = "svg_export_test.svg";
+
+	std::istringstream text("(write-svg \"" + path + "\" (list (make-point 1 2) (make-line (make-point 0 0) (make-point 3 4)) (make-text \"a<b\")))");
+	CHECK(plot.parseStream(text));
+	CHECK_EQ(plot.evaluate().toString(), "(3)");
+
+	std::ifstream svg(path);
+	std::string contents((std::istreambuf_iterator<char>(svg)), std::istreambuf_iterator<char>());
+	CHECK(contents.find("<circle cx=\"1\" cy=\"-2\"") != std::string::npos);
+	CHECK(contents.find("<line x1=\"0\"") != std::string::npos);
+	CHECK(contents.find(">a&lt;b</text>") != std::string::npos);
+	std::remove(path.c_str());
+
+#ifdef __linux__
+	// opens, but every write fails with ENOSPC
+	std::istringstream full("(write-svg \"/dev/full\" (make-point 1 2))");
+	CHECK(plot.parseStream(full));
+	CHECK_THROWS_WITH(plot.evaluate(), "Error: could not write /dev/full");
+#endif
+}